@@ -597,7 +597,7 @@ asf::auto_release_ptr<asr::Material> AppleseedBlendMtl::create_osl_material(
 
     connect_sub_mtl(assembly, shader_group.ref(), name, "BaseMtl", mat);
 
-    const TimeValue time = GetCOREInterface()->GetTime();
+    const TimeValue time = get_shading_time();
     
     asr::ParamArray shader_params;
     int layer_index = 1;
@@ -641,7 +641,7 @@ asf::auto_release_ptr<asr::Material> AppleseedBlendMtl::create_osl_material(
         closure2surface_name.c_str(),
         "in_input");
 
-    assembly.shader_groups().insert(shader_group);
+    shader_group_name = insert_shader_group(assembly, shader_group);
 
     //
     // Material.
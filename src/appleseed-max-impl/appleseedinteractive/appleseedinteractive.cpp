@@ -36,16 +36,37 @@
 #include "appleseedrenderer/projectbuilder.h"
 #include "utilities.h"
 
+// appleseed.renderer headers.
+#include "renderer/api/aov.h"
+#include "renderer/api/frame.h"
+#include "renderer/api/log.h"
+#include "renderer/api/object.h"
+#include "renderer/api/project.h"
+#include "renderer/api/scene.h"
+#include "renderer/api/texture.h"
+#include "renderer/api/utility.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/canvasproperties.h"
+#include "foundation/image/image.h"
+#include "foundation/utility/string.h"
+
 // Boost headers.
 #include "boost/thread/locks.hpp"
 #include "boost/thread/mutex.hpp"
 
 // 3ds Max headers.
 #include <assert1.h>
+#include <imtl.h>
 #include <matrix3.h>
+#include <notify.h>
 
 // Standard headers.
+#include <algorithm>
 #include <clocale>
+#include <cstring>
+#include <string>
+#include <vector>
 
 namespace asf = foundation;
 namespace asr = renderer;
@@ -188,6 +209,112 @@ namespace
         proc.EndEnumeration();
     }
 
+    bool is_camera(INode* node)
+    {
+        Object* object = node->GetObjectRef();
+        return object != nullptr && object->FindBaseObject()->SuperClassID() == CAMERA_CLASS_ID;
+    }
+
+    bool only_cameras(NodeKeyTab& nodes)
+    {
+        for (int i = 0, e = nodes.Count(); i < e; ++i)
+        {
+            INode* node = NodeEventNamespace::GetNodeByKey(nodes[i]);
+            if (node != nullptr && !is_camera(node))
+                return false;
+        }
+
+        return true;
+    }
+
+    // Return an estimate of the memory used by the geometry of an assembly.
+    size_t estimate_geometry_memory_size(const asr::Assembly& assembly)
+    {
+        size_t size = 0;
+
+        for (const asr::Object& object : assembly.objects())
+        {
+            if (std::strcmp(object.get_model(), asr::MeshObjectFactory().get_model()) == 0)
+            {
+                const asr::MeshObject& mesh = static_cast<const asr::MeshObject&>(object);
+                size += mesh.get_vertex_count() * sizeof(asr::GVector3);
+                size += mesh.get_vertex_normal_count() * sizeof(asr::GVector3);
+                size += mesh.get_tex_coords_count() * sizeof(asr::GVector2);
+                size += mesh.get_triangle_count() * sizeof(asr::Triangle);
+            }
+        }
+
+        for (const asr::Assembly& child_assembly : assembly.assemblies())
+            size += estimate_geometry_memory_size(child_assembly);
+
+        return size;
+    }
+
+    // Return an estimate of the memory used by the textures held in memory by a group of entities,
+    // such as baked environment maps and baked procedural maps. The size of textures read from disk
+    // is added to `disk_texture_size` instead.
+    size_t estimate_texture_memory_size(asr::BaseGroup& base_group, size_t& disk_texture_size)
+    {
+        size_t size = 0;
+
+        for (asr::Texture& texture : base_group.textures())
+        {
+            const asf::CanvasProperties& props = texture.properties();
+            const size_t texture_size = props.m_pixel_count * props.m_pixel_size;
+
+            if (std::strcmp(texture.get_model(), asr::DiskTexture2dFactory().get_model()) == 0)
+                disk_texture_size += texture_size;
+            else size += texture_size;
+        }
+
+        for (asr::Assembly& assembly : base_group.assemblies())
+            size += estimate_texture_memory_size(assembly, disk_texture_size);
+
+        return size;
+    }
+
+    // Return an estimate of the memory kept by a project and by the renderer rendering it:
+    // geometry and acceleration structures, textures, the frame and its AOVs, and the buffers
+    // and texture cache of the renderer.
+    size_t estimate_memory_size(asr::Project& project)
+    {
+        asr::Scene& scene = *project.get_scene();
+
+        size_t geometry_size = 0;
+        for (const asr::Assembly& assembly : scene.assemblies())
+            geometry_size += estimate_geometry_memory_size(assembly);
+
+        // Acceleration structures are about as large as the geometry they are built from.
+        size_t size = 2 * geometry_size;
+
+        // Tiles of textures read from disk are cached by the renderer, up to a given amount of memory.
+        size_t disk_texture_size = 0;
+        size += estimate_texture_memory_size(scene, disk_texture_size);
+        const asr::ParamArray params =
+            project.configurations().get_by_name("interactive")->get_inherited_parameters();
+        size += std::min(disk_texture_size, params.get_path_optional<size_t>("texture_store.max_size", 1024 * 1024 * 1024));
+
+        // The frame, its AOVs and the buffer into which the progressive renderer accumulates samples.
+        const asr::Frame& frame = *project.get_frame();
+        const asf::CanvasProperties& props = frame.image().properties();
+        size += (1 + frame.aovs().size()) * props.m_pixel_count * props.m_pixel_size;
+        size += props.m_pixel_count * 5 * sizeof(float);
+
+        return size;
+    }
+
+    // Collect a material and its sub-materials.
+    void collect_materials(Mtl* mtl, std::vector<Mtl*>& mtls)
+    {
+        if (mtl == nullptr || std::find(mtls.begin(), mtls.end(), mtl) != mtls.end())
+            return;
+
+        mtls.push_back(mtl);
+
+        for (int i = 0, e = mtl->NumSubMtls(); i < e; ++i)
+            collect_materials(mtl->GetSubMtl(i), mtls);
+    }
+
     class SceneChangeCallback
       : public INodeEventCallback
     {
@@ -214,18 +341,137 @@ namespace
                 if (NodeEventNamespace::GetNodeByKey(nodes[i]) == m_active_camera)
                 {
                     m_renderer->update_camera_object(m_active_camera);
-                    m_renderer->get_render_session()->reininitialize_render();
                     break;
                 }
             }
         }
 
+        void ControllerOtherEvent(NodeKeyTab& nodes) override
+        {
+            if (m_renderer == nullptr)
+                return;
+
+            std::vector<INode*> moved_nodes;
+            for (int i = 0, e = nodes.Count(); i < e; ++i)
+            {
+                INode* node = NodeEventNamespace::GetNodeByKey(nodes[i]);
+                if (node == nullptr)
+                    continue;
+
+                if (node == m_active_camera)
+                    m_renderer->update_camera_object(m_active_camera);
+                else moved_nodes.push_back(node);
+            }
+
+            // Nodes moved together trigger a single restart of the rendering.
+            m_renderer->update_transforms(moved_nodes);
+        }
+
+        void MaterialOtherEvent(NodeKeyTab& nodes) override
+        {
+            if (m_renderer == nullptr)
+                return;
+
+            std::vector<Mtl*> mtls;
+            for (int i = 0, e = nodes.Count(); i < e; ++i)
+            {
+                INode* node = NodeEventNamespace::GetNodeByKey(nodes[i]);
+                if (node != nullptr)
+                    collect_materials(node->GetMtl(), mtls);
+            }
+
+            if (!mtls.empty())
+                m_renderer->update_materials(mtls);
+        }
+
+        INode* get_active_camera() const
+        {
+            return m_active_camera;
+        }
+
       private:
         SceneEventNamespace::CallbackKey    m_callback_key;
         AppleseedInteractiveRender*         m_renderer;
         INode*                              m_active_camera;
     };
 
+    const int ProjectDirtyingNotifications[] =
+    {
+        NOTIFY_SYSTEM_PRE_RESET,
+        NOTIFY_SYSTEM_PRE_NEW,
+        NOTIFY_FILE_PRE_OPEN,
+        NOTIFY_RENDPARAM_CHANGED
+    };
+
+    // Mark the project as dirty when the scene changes in ways that are not applied to the project.
+    // Changes applied by a running session are ignored. Cameras are rebuilt when a session starts.
+    class ProjectDirtyCallback
+      : public INodeEventCallback
+    {
+      public:
+        explicit ProjectDirtyCallback(AppleseedInteractiveRender* renderer)
+          : m_renderer(renderer)
+        {
+            // Ignore events that happened while the project was built.
+            m_callback_key = GetISceneEventManager()->RegisterCallback(this, false, 100, false);
+
+            for (const int code : ProjectDirtyingNotifications)
+                RegisterNotification(notification_proc, this, code);
+        }
+
+        ~ProjectDirtyCallback() override
+        {
+            for (const int code : ProjectDirtyingNotifications)
+                UnRegisterNotification(notification_proc, this, code);
+
+            GetISceneEventManager()->UnRegisterCallback(m_callback_key);
+        }
+
+        void Added(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void Deleted(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void LinkChanged(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void GroupChanged(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void HierarchyOtherEvent(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void ModelStructured(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void GeometryChanged(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void TopologyChanged(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void MappingChanged(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void ExtentionChannelChanged(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void MaterialStructured(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void ControllerStructured(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void HideChanged(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+        void RenderPropertiesChanged(NodeKeyTab& nodes) override { m_renderer->mark_project_dirty(); }
+
+        void ModelOtherEvent(NodeKeyTab& nodes) override
+        {
+            if (!only_cameras(nodes))
+                m_renderer->mark_project_dirty();
+        }
+
+        void ControllerOtherEvent(NodeKeyTab& nodes) override
+        {
+            if (m_renderer->get_render_session() == nullptr && !only_cameras(nodes))
+                m_renderer->mark_project_dirty();
+        }
+
+        void MaterialOtherEvent(NodeKeyTab& nodes) override
+        {
+            if (m_renderer->get_render_session() == nullptr)
+                m_renderer->mark_project_dirty();
+        }
+
+      private:
+        SceneEventNamespace::CallbackKey    m_callback_key;
+        AppleseedInteractiveRender*         m_renderer;
+
+        static void notification_proc(void* param, NotifyInfo* info)
+        {
+            static_cast<ProjectDirtyCallback*>(param)->m_renderer->mark_project_dirty();
+        }
+    };
+
+    // Forward viewport changes to the render session as soon as they are drawn.
+    // The session decides how quickly rendering restarts.
     class ViewportCallback 
       : public RedrawViewsCallback
     {
@@ -233,8 +479,6 @@ namespace
         ViewportCallback()
           : m_current_view(nullptr)
           , m_last_fov(0.0f)
-          , m_last_timer(0)
-          , m_max_hwnd(GetCOREInterface()->GetMAXHWnd())
         {
             m_last_mat.IdentityMatrix();
 
@@ -246,24 +490,6 @@ namespace
             GetCOREInterface()->UnRegisterRedrawViewsCallback(this);
         }
 
-        static VOID CALLBACK timer_proc(
-            _In_ HWND     hwnd,
-            _In_ UINT     msg,
-            _In_ UINT_PTR id,
-            _In_ DWORD    time
-        )
-        {
-            KillTimer(hwnd, id);
-            {
-                boost::mutex::scoped_lock lock(g_current_interactive_mutex);
-                if (g_current_interactive != nullptr)
-                {
-                    g_current_interactive->update_render_view();
-                    g_current_interactive->get_render_session()->reininitialize_render();
-                }
-            }
-        }
-
         void proc(Interface* ip) override
         {
             ViewExp& view_exp = ip->GetActiveViewExp();
@@ -283,10 +509,10 @@ namespace
                 {
                     m_last_mat = curr_mat;
                     m_last_fov = curr_fov;
-                    if (m_last_timer == 0)
-                        m_last_timer = SetTimer(m_max_hwnd, 0, 100, timer_proc);
-                    else
-                        SetTimer(m_max_hwnd, m_last_timer, 100, timer_proc);
+
+                    boost::mutex::scoped_lock lock(g_current_interactive_mutex);
+                    if (g_current_interactive != nullptr)
+                        g_current_interactive->update_render_view();
                 }
             }
         }
@@ -295,8 +521,6 @@ namespace
         ViewExp*    m_current_view;
         float       m_last_fov;
         Matrix3     m_last_mat;
-        UINT_PTR    m_last_timer;
-        HWND        m_max_hwnd;
     };
 }
 
@@ -314,6 +538,8 @@ AppleseedInteractiveRender::AppleseedInteractiveRender()
   , m_view_inode(nullptr)
   , m_view_exp(nullptr)
   , m_progress_cb(nullptr)
+  , m_use_max_procedural_maps(false)
+  , m_project_dirty(false)
 {
     m_entities.clear();
 }
@@ -322,6 +548,49 @@ AppleseedInteractiveRender::~AppleseedInteractiveRender()
 {
     // Make sure the ActiveShade session has stopped.
     EndSession();
+
+    m_dirty_callback.reset(nullptr);
+    release_project();
+}
+
+bool AppleseedInteractiveRender::ProjectSource::operator==(const ProjectSource& rhs) const
+{
+    return
+        m_time == rhs.m_time &&
+        m_bitmap == rhs.m_bitmap &&
+        m_bitmap_width == rhs.m_bitmap_width &&
+        m_bitmap_height == rhs.m_bitmap_height &&
+        m_iirender_mgr == rhs.m_iirender_mgr &&
+        m_environment_map == rhs.m_environment_map &&
+        (m_environment_map == nullptr ||
+            (m_environment_map_hashed && rhs.m_environment_map_hashed &&
+             m_environment_map_signature == rhs.m_environment_map_signature)) &&
+        m_background == rhs.m_background;
+}
+
+AppleseedInteractiveRender::ProjectSource AppleseedInteractiveRender::get_project_source() const
+{
+    ProjectSource source;
+    source.m_time = m_time;
+    source.m_bitmap = m_bitmap;
+    source.m_bitmap_width = m_bitmap != nullptr ? m_bitmap->Width() : 0;
+    source.m_bitmap_height = m_bitmap != nullptr ? m_bitmap->Height() : 0;
+    source.m_iirender_mgr = m_iirender_mgr;
+    source.m_environment_map = GetCOREInterface()->GetUseEnvironmentMap() ? GetCOREInterface()->GetEnvironmentMap() : nullptr;
+    source.m_environment_map_signature = 0;
+    source.m_environment_map_hashed =
+        source.m_environment_map != nullptr &&
+        compute_texmap_signature(source.m_environment_map, m_time, source.m_environment_map_signature);
+    source.m_background = Color(GetCOREInterface()->GetBackGround(m_time, FOREVER));
+    return source;
+}
+
+void AppleseedInteractiveRender::release_project()
+{
+    m_warm_session.reset(nullptr);
+    m_project.reset();
+    m_material_map.clear();
+    m_instance_map.clear();
 }
 
 asf::auto_release_ptr<asr::Project> AppleseedInteractiveRender::prepare_project(
@@ -349,7 +618,7 @@ asf::auto_release_ptr<asr::Project> AppleseedInteractiveRender::prepare_project(
     m_entities.clear();
 
     MaxSceneEntityCollector collector(m_entities);
-    collector.collect(m_scene_inode);
+    collector.collect(m_scene_inode, time);
 
     // Call RenderBegin() on all object instances.
     render_begin(m_entities.m_objects, time);
@@ -358,6 +627,10 @@ asf::auto_release_ptr<asr::Project> AppleseedInteractiveRender::prepare_project(
     if (m_progress_cb)
         m_progress_cb->SetTitle(L"Building Project...");
 
+    m_material_map.clear();
+    m_instance_map.clear();
+    m_use_max_procedural_maps = renderer_settings.m_use_max_procedural_maps;
+
     asf::auto_release_ptr<asr::Project> project(
         build_project(
             m_entities,
@@ -367,6 +640,10 @@ asf::auto_release_ptr<asr::Project> AppleseedInteractiveRender::prepare_project(
             rend_params,
             frame_rend_params,
             renderer_settings,
+            nullptr,
+            nullptr,
+            &m_material_map,
+            &m_instance_map,
             m_bitmap,
             time,
             m_progress_cb));
@@ -406,15 +683,94 @@ void AppleseedInteractiveRender::update_render_view()
     auto new_camera = build_camera(view_camera, view_params, m_bitmap, RendererSettings::defaults(), m_time);
     get_render_session()->schedule_camera_update(new_camera);
 
-    if (view_camera != nullptr)
+    // Watch the camera node of the viewport, if it changed.
+    if (view_camera != nullptr &&
+        (m_node_callback == nullptr ||
+         static_cast<SceneChangeCallback*>(m_node_callback.get())->get_active_camera() != view_camera))
         m_node_callback.reset(new SceneChangeCallback(this, view_camera));
 }
 
+void AppleseedInteractiveRender::update_materials(const std::vector<Mtl*>& mtls)
+{
+    std::string previous_locale(std::setlocale(LC_ALL, "C"));
+
+    bool updated = false;
+
+    for (const auto& entry : m_material_map)
+    {
+        asr::Assembly* assembly = entry.first.first;
+        Mtl* mtl = entry.first.second;
+
+        if (std::find(mtls.begin(), mtls.end(), mtl) == mtls.end())
+            continue;
+
+        // Materials are rebuilt into a staging assembly since the project is in use by the
+        // rendering thread. They are swapped into the project when rendering restarts.
+        asf::auto_release_ptr<asr::Assembly> staging_assembly(
+            asr::AssemblyFactory().create("staging_assembly"));
+        rebuild_material(staging_assembly.ref(), mtl, entry.second, m_use_max_procedural_maps, m_time);
+        get_render_session()->schedule_material_update(*assembly, entry.second, staging_assembly);
+
+        updated = true;
+    }
+
+    std::setlocale(LC_ALL, previous_locale.c_str());
+
+    if (updated)
+        get_render_session()->reininitialize_render();
+}
+
+void AppleseedInteractiveRender::update_transforms(const std::vector<INode*>& nodes)
+{
+    bool updated = false;
+
+    for (INode* node : nodes)
+    {
+        // Other nodes, such as lights, are not updated by the running session.
+        const auto it = m_instance_map.find(node);
+        if (it == m_instance_map.end())
+        {
+            if (!is_camera(node))
+                mark_project_dirty();
+            continue;
+        }
+
+        const NodeInstances& node_instances = it->second;
+        const asf::Transformd transform = get_node_transform(node, m_time);
+
+        std::unique_ptr<TransformUpdateAction> action(new TransformUpdateAction(node->GetHandle()));
+
+        for (const auto& name : node_instances.m_object_instance_names)
+            action->add_object_instance(*node_instances.m_assembly, name, transform);
+
+        for (const auto& name : node_instances.m_assembly_instance_names)
+            action->add_assembly_instance(*node_instances.m_assembly, name, transform);
+
+        if (action->empty())
+            continue;
+
+        get_render_session()->schedule_transform_update(std::move(action));
+        updated = true;
+    }
+
+    if (updated)
+        get_render_session()->reininitialize_render();
+}
+
 InteractiveSession* AppleseedInteractiveRender::get_render_session()
 {
     return m_render_session.get();
 }
 
+void AppleseedInteractiveRender::mark_project_dirty()
+{
+    m_project_dirty = true;
+
+    // Free the memory used by the project if no session is running.
+    if (m_render_session == nullptr)
+        release_project();
+}
+
 void AppleseedInteractiveRender::BeginSession()
 {
     DbgAssert(m_render_session == nullptr);
@@ -437,13 +793,35 @@ void AppleseedInteractiveRender::BeginSession()
     RendererSettings renderer_settings = appleseed_renderer->get_renderer_settings();
     renderer_settings.m_output_mode = RendererSettings::OutputMode::RenderOnly;
     
-    m_project = prepare_project(renderer_settings, view_params, active_cam, m_time);
+    const ProjectSource project_source = get_project_source();
+
+    if (m_warm_session != nullptr && !m_project_dirty && project_source == m_project_source)
+    {
+        // Resume the session of the previous project, skipping the export of the scene.
+        RENDERER_LOG_INFO("reusing the project of the previous session.");
+
+        render_begin(m_entities.m_objects, m_time);
+
+        m_render_session = std::move(m_warm_session);
+        m_render_session->schedule_camera_update(
+            build_camera(active_cam, view_params, m_bitmap, renderer_settings, m_time));
+    }
+    else
+    {
+        release_project();
+        m_dirty_callback.reset(nullptr);
 
-    m_render_session.reset(new InteractiveSession(
-        m_iirender_mgr,
-        m_project.get(),
-        renderer_settings,
-        m_bitmap));
+        m_project = prepare_project(renderer_settings, view_params, active_cam, m_time);
+        m_project_source = project_source;
+        m_project_dirty = false;
+        m_dirty_callback.reset(new ProjectDirtyCallback(this));
+
+        m_render_session.reset(new InteractiveSession(
+            m_iirender_mgr,
+            m_project.get(),
+            renderer_settings,
+            m_bitmap));
+    }
 
     if (m_progress_cb)
         m_progress_cb->SetTitle(L"Rendering...");
@@ -453,8 +831,7 @@ void AppleseedInteractiveRender::BeginSession()
         g_current_interactive = this;
     }
 
-    if (active_cam != nullptr)
-        m_node_callback.reset(new SceneChangeCallback(this, active_cam));
+    m_node_callback.reset(new SceneChangeCallback(this, active_cam));
     m_view_callback.reset(new ViewportCallback());
 
     m_render_session->start_render();
@@ -483,7 +860,22 @@ void AppleseedInteractiveRender::EndSession()
 
         m_render_session->end_render();
 
-        m_render_session.reset(nullptr);
+        // Keep the session so that the next one can resume it if the scene does not change.
+        const size_t memory_limit =
+            load_system_setting<size_t>(L"ActiveShadeProjectMemoryLimit", 1024) * 1024 * 1024;
+        const size_t memory_size = estimate_memory_size(m_project.ref());
+        if (!m_project_dirty && memory_size <= memory_limit)
+        {
+            RENDERER_LOG_INFO(
+                "keeping the project (%s) for the next session.",
+                asf::pretty_size(memory_size).c_str());
+            m_warm_session = std::move(m_render_session);
+        }
+        else
+        {
+            m_render_session.reset(nullptr);
+            release_project();
+        }
     }
     
     render_end(m_entities.m_objects, m_time);
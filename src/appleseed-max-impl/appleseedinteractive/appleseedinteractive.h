@@ -30,8 +30,10 @@
 
 // appleseed-max headers.
 #include "appleseedrenderer/maxsceneentities.h"
+#include "appleseedrenderer/projectbuilder.h"
 
 // appleseed.foundation headers.
+#include "foundation/platform/types.h"
 #include "foundation/platform/windows.h"    // include before 3ds Max headers
 #include "foundation/utility/autoreleaseptr.h"
 
@@ -98,19 +100,47 @@ class AppleseedInteractiveRender
 
     void update_camera_object(INode* camera);
     void update_render_view();
+    void update_materials(const std::vector<Mtl*>& mtls);
+    void update_transforms(const std::vector<INode*>& nodes);
     InteractiveSession* get_render_session();
 
+    // Mark the project as outdated, so that the next session does not reuse it.
+    void mark_project_dirty();
+
   private:
+    // Inputs of the project other than the scene itself.
+    struct ProjectSource
+    {
+        TimeValue                                   m_time;
+        Bitmap*                                     m_bitmap;
+        int                                         m_bitmap_width;
+        int                                         m_bitmap_height;
+        IIRenderMgr*                                m_iirender_mgr;
+        Texmap*                                     m_environment_map;
+        bool                                        m_environment_map_hashed;       // false if the environment map can't be hashed
+        foundation::uint64                          m_environment_map_signature;    // detects edits of the environment map
+        Color                                       m_background;
+
+        bool operator==(const ProjectSource& rhs) const;
+    };
+
     std::unique_ptr<InteractiveSession>             m_render_session;
+    std::unique_ptr<InteractiveSession>             m_warm_session;     // session of the last project, kept to be resumed
+    std::unique_ptr<INodeEventCallback>             m_dirty_callback;
     std::unique_ptr<INodeEventCallback>             m_node_callback;
     std::unique_ptr<RedrawViewsCallback>            m_view_callback;
     foundation::auto_release_ptr<renderer::Project> m_project;
+    ProjectSource                                   m_project_source;
+    bool                                            m_project_dirty;
     Bitmap*                                         m_bitmap;
     std::vector<DefaultLight>                       m_default_lights;
     IIRenderMgr*                                    m_iirender_mgr;
     HWND                                            m_owner_wnd;
     IRenderProgressCallback*                        m_progress_cb;
     MaxSceneEntities                                m_entities;
+    MaterialMap                                     m_material_map;
+    InstanceMap                                     m_instance_map;
+    bool                                            m_use_max_procedural_maps;
     TimeValue                                       m_time;
     Box2                                            m_region;
     INode*                                          m_scene_inode;
@@ -123,4 +153,8 @@ class AppleseedInteractiveRender
         const ViewParams&           view_params,
         INode*                      camera_node,
         const TimeValue             time);
+
+    ProjectSource get_project_source() const;
+
+    void release_project();
 };
@@ -29,26 +29,547 @@
 // Interface header.
 #include "interactiverenderercontroller.h"
 
+// appleseed.renderer headers.
+#include "renderer/api/bsdf.h"
+#include "renderer/api/bssrdf.h"
+#include "renderer/api/camera.h"
+#include "renderer/api/color.h"
+#include "renderer/api/edf.h"
+#include "renderer/api/frame.h"
+#include "renderer/api/light.h"
+#include "renderer/api/log.h"
+#include "renderer/api/material.h"
+#include "renderer/api/object.h"
+#include "renderer/api/shadergroup.h"
+#include "renderer/api/surfaceshader.h"
+#include "renderer/api/texture.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/canvasproperties.h"
+#include "foundation/image/image.h"
+#include "foundation/utility/containers/dictionary.h"
+#include "foundation/utility/string.h"
+
 // 3ds Max headers.
 #include <interactiverender.h>
 
 // Standard headers.
+#include <algorithm>
+#include <map>
+#include <set>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
+namespace asf = foundation;
 namespace asr = renderer;
 
-InteractiveRendererController::InteractiveRendererController()
-  : m_status(ContinueRendering)
+namespace
 {
+    // Divisors of the resolution used while the camera moves.
+    const size_t InitialNavigationDivisor = 4;
+    const size_t MinNavigationDivisor = 2;
+    const size_t MaxNavigationDivisor = 8;
+
+    // Delay after the last camera change before rendering restarts at full resolution.
+    const std::chrono::milliseconds SettleDelay(300);
+
+    // Camera changes let passes complete when passes take less than this.
+    const std::chrono::milliseconds MaxFoldedPassDuration(40);
+
+    asf::Vector2i get_resolution(const asr::Frame& frame)
+    {
+        const asf::CanvasProperties& props = frame.image().properties();
+        return
+            asf::Vector2i(
+                static_cast<int>(props.m_canvas_width),
+                static_cast<int>(props.m_canvas_height));
+    }
+
+    typedef std::map<std::string, std::string> NameMap;
+
+    // Choose names for the entities of a container that are unique in both containers.
+    template <typename Entity>
+    void make_unique_names(
+        const asr::TypedEntityVector<Entity>&   source,
+        const asr::TypedEntityVector<Entity>&   destination,
+        NameMap&                                new_names)
+    {
+        std::set<std::string> assigned_names;
+
+        for (const Entity& entity : source)
+        {
+            const std::string name = entity.get_name();
+            std::string new_name = name;
+
+            for (size_t suffix = 1;
+                 destination.get_by_name(new_name.c_str()) != nullptr ||
+                 (new_name != name && source.get_by_name(new_name.c_str()) != nullptr) ||
+                 assigned_names.count(new_name) > 0;
+                 ++suffix)
+                new_name = asf::format("{0}_{1}", name, suffix);
+
+            assigned_names.insert(new_name);
+            new_names[name] = new_name;
+        }
+    }
+
+    // Replace parameter values that are the old name of a renamed entity by its new name.
+    void rename_references(asf::Dictionary& params, const NameMap& new_names)
+    {
+        std::vector<std::pair<std::string, std::string>> renamed_values;
+        for (auto i = params.strings().begin(), e = params.strings().end(); i != e; ++i)
+        {
+            const auto it = new_names.find(i.value());
+            if (it != new_names.end() && it->first != it->second)
+                renamed_values.emplace_back(i.key(), it->second);
+        }
+
+        for (const auto& entry : renamed_values)
+            params.insert(entry.first.c_str(), entry.second);
+
+        std::vector<std::string> keys;
+        for (auto i = params.dictionaries().begin(), e = params.dictionaries().end(); i != e; ++i)
+            keys.push_back(i.key());
+
+        for (const auto& key : keys)
+            rename_references(params.dictionaries().get(key.c_str()), new_names);
+    }
+
+    template <typename Entity>
+    void rename_references(asr::TypedEntityVector<Entity>& entities, const NameMap& new_names)
+    {
+        for (Entity& entity : entities)
+            rename_references(entity.get_parameters(), new_names);
+    }
+
+    // Move all entities of a container to another, giving them their new names.
+    template <typename Entity>
+    void move_entities(
+        asr::TypedEntityVector<Entity>&     source,
+        asr::TypedEntityVector<Entity>&     destination,
+        const NameMap&                      new_names)
+    {
+        while (!source.empty())
+        {
+            asf::auto_release_ptr<Entity> entity = source.remove(&*source.begin());
+            entity->set_name(new_names.at(entity->get_name()).c_str());
+            destination.insert(entity);
+        }
+    }
+
+    // Texture instances store the name of their texture outside of their parameters,
+    // so they are recreated instead.
+    void move_texture_instances(
+        asr::TextureInstanceContainer&      source,
+        asr::TextureInstanceContainer&      destination,
+        const NameMap&                      new_names)
+    {
+        while (!source.empty())
+        {
+            asf::auto_release_ptr<asr::TextureInstance> texture_instance =
+                source.remove(&*source.begin());
+
+            const auto texture_name = new_names.find(texture_instance->get_texture_name());
+            destination.insert(
+                asr::TextureInstanceFactory::create(
+                    new_names.at(texture_instance->get_name()).c_str(),
+                    texture_instance->get_parameters(),
+                    texture_name != new_names.end()
+                        ? texture_name->second.c_str()
+                        : texture_instance->get_texture_name()));
+        }
+    }
+
+    typedef std::unordered_set<const asr::Entity*> EntitySet;
+
+    // Return the entity of an assembly that a parameter value may refer to, or nullptr.
+    const asr::Entity* find_entity(const asr::Assembly& assembly, const char* name)
+    {
+        const asr::Entity* entity = assembly.colors().get_by_name(name);
+        if (entity == nullptr)
+            entity = assembly.textures().get_by_name(name);
+        if (entity == nullptr)
+            entity = assembly.texture_instances().get_by_name(name);
+        if (entity == nullptr)
+            entity = assembly.shader_groups().get_by_name(name);
+        if (entity == nullptr)
+            entity = assembly.bsdfs().get_by_name(name);
+        if (entity == nullptr)
+            entity = assembly.bssrdfs().get_by_name(name);
+        if (entity == nullptr)
+            entity = assembly.edfs().get_by_name(name);
+        if (entity == nullptr)
+            entity = assembly.surface_shaders().get_by_name(name);
+        return entity;
+    }
+
+    void collect_referenced_entities(
+        const asr::Assembly&    assembly,
+        const asf::Dictionary&  params,
+        EntitySet&              entities);
+
+    // Add an entity of an assembly, and the entities it references, to a set.
+    void collect_entity(
+        const asr::Assembly&    assembly,
+        const char*             name,
+        EntitySet&              entities)
+    {
+        const asr::Entity* entity = find_entity(assembly, name);
+        if (entity == nullptr || !entities.insert(entity).second)
+            return;
+
+        collect_referenced_entities(assembly, entity->get_parameters(), entities);
+
+        const asr::TextureInstance* texture_instance = dynamic_cast<const asr::TextureInstance*>(entity);
+        if (texture_instance != nullptr)
+            collect_entity(assembly, texture_instance->get_texture_name(), entities);
+    }
+
+    // Add the entities of an assembly referenced, directly or not, by a set of parameters to a set.
+    void collect_referenced_entities(
+        const asr::Assembly&    assembly,
+        const asf::Dictionary&  params,
+        EntitySet&              entities)
+    {
+        for (auto i = params.strings().begin(), e = params.strings().end(); i != e; ++i)
+            collect_entity(assembly, i.value(), entities);
+
+        for (auto i = params.dictionaries().begin(), e = params.dictionaries().end(); i != e; ++i)
+            collect_referenced_entities(assembly, i.value(), entities);
+    }
+
+    // Add the entities of `assembly` used by the materials, lights and objects of `user`,
+    // an assembly that is either `assembly` or one of its descendants, to a set.
+    void collect_used_entities(
+        const asr::Assembly&    assembly,
+        const asr::Assembly&    user,
+        EntitySet&              entities)
+    {
+        for (const asr::Material& material : user.materials())
+            collect_referenced_entities(assembly, material.get_parameters(), entities);
+
+        for (const asr::Light& light : user.lights())
+            collect_referenced_entities(assembly, light.get_parameters(), entities);
+
+        for (const asr::Object& object : user.objects())
+            collect_referenced_entities(assembly, object.get_parameters(), entities);
+
+        // Entities of an assembly can also be referenced from its child assemblies.
+        for (const asr::Assembly& child_assembly : user.assemblies())
+            collect_used_entities(assembly, child_assembly, entities);
+    }
+
+    // Remove the entities of a container that belong to `candidates` but not to `used`.
+    template <typename Entity>
+    void remove_unused_entities(
+        asr::TypedEntityVector<Entity>&     entities,
+        const EntitySet&                    candidates,
+        const EntitySet&                    used)
+    {
+        std::vector<Entity*> unused;
+        for (Entity& entity : entities)
+        {
+            if (candidates.find(&entity) != candidates.end() && used.find(&entity) == used.end())
+                unused.push_back(&entity);
+        }
+
+        for (Entity* entity : unused)
+            entities.remove(entity);
+    }
+}
+
+
+//
+// ScheduledAction class implementation.
+//
+
+ScheduledAction::ScheduledAction(const std::string& key)
+  : m_key(key)
+{
+}
+
+const std::string& ScheduledAction::get_key() const
+{
+    return m_key;
+}
+
+
+//
+// MaterialUpdateAction class implementation.
+//
+
+MaterialUpdateAction::MaterialUpdateAction(
+    asr::Assembly&                          assembly,
+    const std::string&                      material_name,
+    asf::auto_release_ptr<asr::Assembly>    staging_assembly)
+  : ScheduledAction(asf::format("material:{0}:{1}", assembly.get_uid(), material_name))
+  , m_assembly(assembly)
+  , m_material_name(material_name)
+  , m_staging_assembly(staging_assembly)
+{
+}
+
+ScheduledAction::Order MaterialUpdateAction::get_order() const
+{
+    return MaterialUpdateOrder;
+}
+
+void MaterialUpdateAction::update()
+{
+    asr::Assembly& staging = m_staging_assembly.ref();
+
+    // Entities with the same names as rebuilt entities may be used by other materials,
+    // so rebuilt entities are given names that are not used in the assembly yet.
+    NameMap new_names;
+    make_unique_names(staging.colors(), m_assembly.colors(), new_names);
+    make_unique_names(staging.textures(), m_assembly.textures(), new_names);
+    make_unique_names(staging.texture_instances(), m_assembly.texture_instances(), new_names);
+    make_unique_names(staging.shader_groups(), m_assembly.shader_groups(), new_names);
+    make_unique_names(staging.bsdfs(), m_assembly.bsdfs(), new_names);
+    make_unique_names(staging.bssrdfs(), m_assembly.bssrdfs(), new_names);
+    make_unique_names(staging.edfs(), m_assembly.edfs(), new_names);
+    make_unique_names(staging.surface_shaders(), m_assembly.surface_shaders(), new_names);
+
+    rename_references(staging.texture_instances(), new_names);
+    rename_references(staging.bsdfs(), new_names);
+    rename_references(staging.bssrdfs(), new_names);
+    rename_references(staging.edfs(), new_names);
+    rename_references(staging.surface_shaders(), new_names);
+    rename_references(staging.materials(), new_names);
+
+    move_entities(staging.colors(), m_assembly.colors(), new_names);
+    move_entities(staging.textures(), m_assembly.textures(), new_names);
+    move_texture_instances(staging.texture_instances(), m_assembly.texture_instances(), new_names);
+    move_entities(staging.shader_groups(), m_assembly.shader_groups(), new_names);
+    move_entities(staging.bsdfs(), m_assembly.bsdfs(), new_names);
+    move_entities(staging.bssrdfs(), m_assembly.bssrdfs(), new_names);
+    move_entities(staging.edfs(), m_assembly.edfs(), new_names);
+    move_entities(staging.surface_shaders(), m_assembly.surface_shaders(), new_names);
+
+    // Only the edited material is replaced. The entities used by its previous version are
+    // collected by following references, which also covers entities created with the project.
+    EntitySet previous_entities;
+    asr::Material* previous_material = m_assembly.materials().get_by_name(m_material_name.c_str());
+    if (previous_material != nullptr)
+    {
+        collect_referenced_entities(m_assembly, previous_material->get_parameters(), previous_entities);
+        m_assembly.materials().remove(previous_material);
+    }
+
+    asr::Material* material = staging.materials().get_by_name(m_material_name.c_str());
+    if (material != nullptr)
+        m_assembly.materials().insert(staging.materials().remove(material));
+
+    // Remove the entities of the previous version of the material that are no longer used.
+    if (!previous_entities.empty())
+    {
+        EntitySet used_entities;
+        collect_used_entities(m_assembly, m_assembly, used_entities);
+
+        remove_unused_entities(m_assembly.surface_shaders(), previous_entities, used_entities);
+        remove_unused_entities(m_assembly.edfs(), previous_entities, used_entities);
+        remove_unused_entities(m_assembly.bssrdfs(), previous_entities, used_entities);
+        remove_unused_entities(m_assembly.bsdfs(), previous_entities, used_entities);
+        remove_unused_entities(m_assembly.shader_groups(), previous_entities, used_entities);
+        remove_unused_entities(m_assembly.texture_instances(), previous_entities, used_entities);
+        remove_unused_entities(m_assembly.textures(), previous_entities, used_entities);
+        remove_unused_entities(m_assembly.colors(), previous_entities, used_entities);
+    }
+}
+
+
+//
+// TransformUpdateAction class implementation.
+//
+
+TransformUpdateAction::TransformUpdateAction(const ULONG node_handle)
+  : ScheduledAction(asf::format("transform:{0}", node_handle))
+{
+}
+
+void TransformUpdateAction::add_object_instance(
+    asr::Assembly&                          assembly,
+    const std::string&                      name,
+    const asf::Transformd&                  transform)
+{
+    InstanceTransform instance_transform;
+    instance_transform.m_assembly = &assembly;
+    instance_transform.m_name = name;
+    instance_transform.m_transform = transform;
+    m_object_instances.push_back(instance_transform);
+}
+
+void TransformUpdateAction::add_assembly_instance(
+    asr::Assembly&                          assembly,
+    const std::string&                      name,
+    const asf::Transformd&                  transform)
+{
+    InstanceTransform instance_transform;
+    instance_transform.m_assembly = &assembly;
+    instance_transform.m_name = name;
+    instance_transform.m_transform = transform;
+    m_assembly_instances.push_back(instance_transform);
+}
+
+bool TransformUpdateAction::empty() const
+{
+    return m_object_instances.empty() && m_assembly_instances.empty();
+}
+
+ScheduledAction::Order TransformUpdateAction::get_order() const
+{
+    return TransformUpdateOrder;
+}
+
+void TransformUpdateAction::update()
+{
+    // The transform of an object instance is fixed at creation, hence object instances are
+    // recreated. Only the acceleration structure of the assembly containing them is rebuilt.
+    for (const InstanceTransform& instance_transform : m_object_instances)
+    {
+        asr::ObjectInstanceContainer& object_instances = instance_transform.m_assembly->object_instances();
+        asr::ObjectInstance* object_instance = object_instances.get_by_name(instance_transform.m_name.c_str());
+        if (object_instance == nullptr)
+            continue;
+
+        asf::auto_release_ptr<asr::ObjectInstance> new_object_instance(
+            asr::ObjectInstanceFactory::create(
+                object_instance->get_name(),
+                object_instance->get_parameters(),
+                object_instance->get_object_name(),
+                instance_transform.m_transform,
+                object_instance->get_front_material_mappings(),
+                object_instance->get_back_material_mappings()));
+
+        object_instances.remove(object_instance);
+        object_instances.insert(new_object_instance);
+    }
+
+    // Moving assembly instances leaves the acceleration structures of their assemblies untouched.
+    for (const InstanceTransform& instance_transform : m_assembly_instances)
+    {
+        asr::AssemblyInstance* assembly_instance =
+            instance_transform.m_assembly->assembly_instances().get_by_name(instance_transform.m_name.c_str());
+        if (assembly_instance == nullptr)
+            continue;
+
+        assembly_instance->transform_sequence().clear();
+        assembly_instance->transform_sequence().set_transform(0.0, instance_transform.m_transform);
+        assembly_instance->bump_version_id();
+    }
+}
+
+
+//
+// InteractiveRendererController class implementation.
+//
+
+InteractiveRendererController::InteractiveRendererController(
+    asr::Project&                           project,
+    const std::chrono::milliseconds         target_frame_time)
+  : m_project(project)
+  , m_target_frame_time(target_frame_time)
+  , m_frame_name(project.get_frame()->get_name())
+  , m_frame_params(project.get_frame()->get_parameters())
+  , m_has_crop_window(project.get_frame()->has_crop_window())
+  , m_crop_window(project.get_frame()->get_crop_window())
+  , m_full_resolution(get_resolution(*project.get_frame()))
+  , m_statistics()
+  , m_status(ContinueRendering)
+  , m_camera_mailbox(nullptr)
+  , m_camera_change_folded(false)
+  , m_pass_duration(Clock::duration::max().count())
+  , m_last_update_time(0)
+  , m_navigating(false)
+  , m_last_camera_change(0)
+  , m_divisor(1)
+  , m_navigation_divisor(InitialNavigationDivisor)
+  , m_first_update_received(false)
+{
+    const asr::AOVFactoryRegistrar aov_factory_registrar;
+    for (const asr::AOV& aov : project.get_frame()->aovs())
+    {
+        const asr::IAOVFactory* factory = aov_factory_registrar.lookup(aov.get_model());
+        if (factory == nullptr)
+        {
+            RENDERER_LOG_WARNING(
+                "aov \"%s\" of unknown model \"%s\" will be missing from frames after navigation.",
+                aov.get_name(),
+                aov.get_model());
+            continue;
+        }
+
+        m_frame_aovs.insert(factory->create(aov.get_parameters()));
+    }
+}
+
+InteractiveRendererController::~InteractiveRendererController()
+{
+    asr::Camera* camera = m_camera_mailbox.exchange(nullptr);
+    if (camera != nullptr)
+        camera->release();
 }
 
 void InteractiveRendererController::on_rendering_begin()
 {
-    for (auto& updater : m_scheduled_actions)
-        updater->update();
-    
-    m_scheduled_actions.clear();
+    // Actions are scheduled from the UI thread while this runs in the rendering thread.
+    std::vector<std::unique_ptr<ScheduledAction>> scheduled_actions;
+    {
+        std::lock_guard<std::mutex> lock(m_scheduled_actions_mutex);
+        scheduled_actions.swap(m_scheduled_actions);
+        m_scheduled_action_indices.clear();
+    }
+
+    if (!scheduled_actions.empty())
+    {
+        const auto apply_begin_time = Clock::now();
+
+        std::stable_sort(
+            scheduled_actions.begin(),
+            scheduled_actions.end(),
+            [](const std::unique_ptr<ScheduledAction>& lhs, const std::unique_ptr<ScheduledAction>& rhs)
+            {
+                return lhs->get_order() < rhs->get_order();
+            });
+
+        for (auto& updater : scheduled_actions)
+            updater->update();
+
+        const double apply_time =
+            std::chrono::duration<double>(Clock::now() - apply_begin_time).count();
+
+        {
+            std::lock_guard<std::mutex> lock(m_scheduled_actions_mutex);
+            m_statistics.m_applied_count += scheduled_actions.size();
+            m_statistics.m_apply_time += apply_time;
+        }
+
+        RENDERER_LOG_DEBUG(
+            "applied %s scheduled update(s) in %s.",
+            asf::pretty_uint(scheduled_actions.size()).c_str(),
+            asf::pretty_time(apply_time).c_str());
+    }
+
+    // Reset the status before taking the camera: a camera posted after this point is either
+    // taken below or requests a restart that is not overwritten.
     m_status = ContinueRendering;
+    m_camera_change_folded = false;
+
+    // Apply the most recent camera.
+    asr::Camera* camera = m_camera_mailbox.exchange(nullptr);
+    if (camera != nullptr)
+    {
+        asr::CameraContainer& cameras = m_project.get_scene()->cameras();
+        cameras.clear();
+        cameras.insert(asf::auto_release_ptr<asr::Camera>(camera));
+    }
+
+    // Render at reduced resolution while the camera moves.
+    set_resolution_divisor(m_navigating ? m_navigation_divisor : 1);
+
+    m_rendering_begin_time = Clock::now();
+    m_first_update_received = false;
 }
 
 asr::IRendererController::Status InteractiveRendererController::get_status() const
@@ -63,5 +584,146 @@ void InteractiveRendererController::set_status(const Status status)
 
 void InteractiveRendererController::schedule_update(std::unique_ptr<ScheduledAction> updater)
 {
+    std::lock_guard<std::mutex> lock(m_scheduled_actions_mutex);
+
+    ++m_statistics.m_scheduled_count;
+
+    // Replace a pending action with the same key, only the most recent one matters.
+    const auto inserted =
+        m_scheduled_action_indices.insert(
+            std::make_pair(updater->get_key(), m_scheduled_actions.size()));
+    if (!inserted.second)
+    {
+        m_scheduled_actions[inserted.first->second] = std::move(updater);
+        ++m_statistics.m_coalesced_count;
+        return;
+    }
+
     m_scheduled_actions.push_back(std::move(updater));
+    m_statistics.m_max_queue_depth = std::max(m_statistics.m_max_queue_depth, m_scheduled_actions.size());
+}
+
+size_t InteractiveRendererController::get_queue_depth() const
+{
+    std::lock_guard<std::mutex> lock(m_scheduled_actions_mutex);
+    return m_scheduled_actions.size();
+}
+
+InteractiveRendererController::Statistics InteractiveRendererController::get_statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_scheduled_actions_mutex);
+    return m_statistics;
+}
+
+void InteractiveRendererController::post_camera(asf::auto_release_ptr<asr::Camera> camera)
+{
+    const Clock::time_point now = Clock::now();
+
+    // Only the most recent camera matters.
+    asr::Camera* previous_camera = m_camera_mailbox.exchange(camera.release());
+    if (previous_camera != nullptr)
+        previous_camera->release();
+
+    if (m_target_frame_time.count() > 0)
+    {
+        m_last_camera_change = now.time_since_epoch().count();
+        m_navigating = true;
+    }
+
+    // Let the current pass complete if passes are short and still being displayed, since the
+    // restart will then happen shortly. Otherwise, abort the current pass right away.
+    const Clock::duration pass_duration(m_pass_duration.load());
+    const Clock::time_point last_update_time(Clock::duration(m_last_update_time.load()));
+    if (pass_duration < MaxFoldedPassDuration && now - last_update_time < MaxFoldedPassDuration)
+        m_camera_change_folded = true;
+    else restart_rendering();
+}
+
+void InteractiveRendererController::on_frame_update()
+{
+    const Clock::time_point now = Clock::now();
+    m_last_update_time = now.time_since_epoch().count();
+
+    if (!m_first_update_received)
+    {
+        m_first_update_received = true;
+
+        const auto frame_time = now - m_rendering_begin_time;
+        m_pass_duration = frame_time.count();
+
+        // Adapt the resolution of the next frames to the time it took to display this one.
+        if (m_navigating && m_divisor > 1)
+        {
+            if (frame_time > m_target_frame_time && m_navigation_divisor < MaxNavigationDivisor)
+                m_navigation_divisor *= 2;
+            else if (frame_time < m_target_frame_time / 4 && m_navigation_divisor > MinNavigationDivisor)
+                m_navigation_divisor /= 2;
+        }
+    }
+
+    // This pass was displayed, apply camera changes that were waiting for it.
+    if (m_camera_change_folded.exchange(false))
+    {
+        restart_rendering();
+        return;
+    }
+
+    if (!m_navigating)
+        return;
+
+    // Restart at full resolution once the camera stopped moving.
+    const Clock::time_point last_camera_change(Clock::duration(m_last_camera_change.load()));
+    if (now - last_camera_change > SettleDelay)
+    {
+        m_navigating = false;
+        if (m_divisor > 1)
+            restart_rendering();
+    }
+}
+
+void InteractiveRendererController::restart_rendering()
+{
+    Status expected = ContinueRendering;
+    m_status.compare_exchange_strong(expected, ReinitializeRendering);
+}
+
+void InteractiveRendererController::set_resolution_divisor(const size_t divisor)
+{
+    if (divisor == m_divisor)
+        return;
+
+    m_divisor = divisor;
+
+    // Replace the frame by a frame like the original one at a different resolution. Only the
+    // beauty image is displayed while navigating, hence frames at reduced resolution have no AOVs.
+    const asf::Vector2i resolution(
+        std::max(m_full_resolution.x / static_cast<int>(divisor), 1),
+        std::max(m_full_resolution.y / static_cast<int>(divisor), 1));
+
+    asr::ParamArray params = m_frame_params;
+    params.insert("resolution", resolution);
+
+    const asr::AOVContainer no_aovs;
+    asf::auto_release_ptr<asr::Frame> frame(
+        asr::FrameFactory::create(
+            m_frame_name.c_str(),
+            params,
+            divisor == 1 ? m_frame_aovs : no_aovs));
+
+    // Scale the crop window of region renders.
+    if (m_has_crop_window)
+    {
+        const size_t max_x = static_cast<size_t>(resolution.x - 1);
+        const size_t max_y = static_cast<size_t>(resolution.y - 1);
+        frame->set_crop_window(
+            asf::AABB2u(
+                asf::Vector2u(
+                    static_cast<asf::uint32>(std::min(m_crop_window.min.x / divisor, max_x)),
+                    static_cast<asf::uint32>(std::min(m_crop_window.min.y / divisor, max_y))),
+                asf::Vector2u(
+                    static_cast<asf::uint32>(std::min(m_crop_window.max.x / divisor, max_x)),
+                    static_cast<asf::uint32>(std::min(m_crop_window.max.y / divisor, max_y)))));
+    }
+
+    m_project.set_frame(frame);
 }
@@ -29,59 +29,146 @@
 #pragma once
 
 // appleseed.renderer headers.
+#include "renderer/api/aov.h"
 #include "renderer/api/project.h"
 #include "renderer/api/rendering.h"
 #include "renderer/api/scene.h"
 
 // appleseed.foundation headers.
+#include "foundation/math/aabb.h"
+#include "foundation/math/transform.h"
+#include "foundation/math/vector.h"
 #include "foundation/utility/autoreleaseptr.h"
 
 // appleseed-max headers.
 #include "appleseedinteractive/appleseedinteractive.h"
 
 // Standard headers.
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 // Forward declarations.
+namespace renderer { class Assembly; }
 namespace renderer { class Camera; }
 namespace renderer { class Project; }
 
+//
+// An update of the project scheduled from the UI thread and applied by the rendering thread
+// before rendering restarts.
+//
+
 class ScheduledAction
 {
   public:
+    // Actions are applied in this order, so that entities are updated before the entities
+    // referencing them. Actions of the same order are applied in the order they were scheduled.
+    // The camera, which is not updated through scheduled actions, is updated last.
+    enum Order
+    {
+        MaterialUpdateOrder,
+        TransformUpdateOrder
+    };
+
     virtual ~ScheduledAction() {}
+
+    virtual Order get_order() const = 0;
+
+    // A scheduled action replaces any pending action with the same key.
+    const std::string& get_key() const;
+
     virtual void update() = 0;
+
+  protected:
+    // The key is computed once, when the action is created.
+    explicit ScheduledAction(const std::string& key);
+
+  private:
+    const std::string m_key;
 };
 
-class CameraObjectUpdateAction 
+class MaterialUpdateAction
   : public ScheduledAction
 {
   public:
-    CameraObjectUpdateAction(
-        renderer::Project&                              project,
-        foundation::auto_release_ptr<renderer::Camera>  camera)
-      : m_project(project)
-      , m_camera(camera)
-    {
-    }
+    // `staging_assembly` holds a rebuilt material and the entities it depends on. The material
+    // replaces the material with the same name in `assembly`. The entities it depends on are
+    // added to `assembly` under new unique names, since entities with the same names may be
+    // used by other materials. Entities only used by the replaced material are removed.
+    MaterialUpdateAction(
+        renderer::Assembly&                                 assembly,
+        const std::string&                                  material_name,
+        foundation::auto_release_ptr<renderer::Assembly>    staging_assembly);
+
+    Order get_order() const override;
+    void update() override;
 
-    void update() override
-    {
-        m_project.get_scene()->cameras().clear();
-        m_project.get_scene()->cameras().insert(m_camera);
-    }
+  private:
+    renderer::Assembly&                                 m_assembly;
+    const std::string                                   m_material_name;
+    foundation::auto_release_ptr<renderer::Assembly>    m_staging_assembly;
+};
 
+class TransformUpdateAction
+  : public ScheduledAction
+{
   public:
-    foundation::auto_release_ptr<renderer::Camera>    m_camera;
-    renderer::Project&                                m_project;
+    // Instances of a 3ds Max node, identified by its handle, are updated by a single action.
+    explicit TransformUpdateAction(const ULONG node_handle);
+
+    void add_object_instance(
+        renderer::Assembly&             assembly,
+        const std::string&              name,
+        const foundation::Transformd&   transform);
+
+    void add_assembly_instance(
+        renderer::Assembly&             assembly,
+        const std::string&              name,
+        const foundation::Transformd&   transform);
+
+    bool empty() const;
+
+    Order get_order() const override;
+    void update() override;
+
+  private:
+    struct InstanceTransform
+    {
+        renderer::Assembly*             m_assembly;
+        std::string                     m_name;
+        foundation::Transformd          m_transform;
+    };
+
+    std::vector<InstanceTransform>      m_object_instances;
+    std::vector<InstanceTransform>      m_assembly_instances;
 };
 
+//
+// Camera changes are posted to a mailbox that holds the most recent camera. Depending on how long
+// rendering passes take, the current pass is either aborted right away or allowed to complete, in
+// which case rendering restarts with the new camera as soon as the pass was displayed.
+//
+// While the camera is moving, frames are rendered at a fraction of the full resolution so that the
+// first pass after each camera change is displayed within a target frame time. The divisor of the
+// resolution is adapted to the time it took to display the first pass of previous frames. Once the
+// camera has not moved for a while, rendering restarts at full resolution.
+//
+
 class InteractiveRendererController
   : public renderer::DefaultRendererController
 {
   public:
-    InteractiveRendererController();
+    // A target frame time of zero disables the reduction of the resolution.
+    InteractiveRendererController(
+        renderer::Project&                          project,
+        const std::chrono::milliseconds             target_frame_time);
+
+    ~InteractiveRendererController() override;
 
     void on_rendering_begin() override;
     Status get_status() const override;
@@ -90,7 +177,62 @@ class InteractiveRendererController
 
     void schedule_update(std::unique_ptr<ScheduledAction> updater);
 
+    // Return the number of actions waiting to be applied.
+    size_t get_queue_depth() const;
+
+    struct Statistics
+    {
+        size_t      m_scheduled_count;      // number of scheduled actions
+        size_t      m_coalesced_count;      // number of actions replaced by a more recent action with the same key
+        size_t      m_applied_count;        // number of applied actions
+        size_t      m_max_queue_depth;      // maximum number of actions waiting to be applied
+        double      m_apply_time;           // total time spent applying actions, in seconds
+    };
+
+    Statistics get_statistics() const;
+
+    // Post a new camera. Called from the UI thread, never blocks.
+    void post_camera(foundation::auto_release_ptr<renderer::Camera> camera);
+
+    // Called from the rendering thread when a progressive update of the frame was published.
+    void on_frame_update();
+
   private:
+    typedef std::chrono::steady_clock Clock;
+
+    renderer::Project&                              m_project;
+    const std::chrono::milliseconds                 m_target_frame_time;
+
+    // Description of the original frame, from which frames at any resolution are created.
+    const std::string                               m_frame_name;
+    const renderer::ParamArray                      m_frame_params;
+    renderer::AOVContainer                          m_frame_aovs;
+    const bool                                      m_has_crop_window;
+    const foundation::AABB2u                        m_crop_window;
+    const foundation::Vector2i                      m_full_resolution;
+
+    mutable std::mutex                              m_scheduled_actions_mutex;
     std::vector<std::unique_ptr<ScheduledAction>>   m_scheduled_actions;
-    Status                                          m_status;
+    std::unordered_map<std::string, size_t>         m_scheduled_action_indices; // index in m_scheduled_actions of the pending action with a given key
+    Statistics                                      m_statistics;
+
+    // Accessed from the UI thread and the rendering thread.
+    std::atomic<Status>                             m_status;
+    std::atomic<renderer::Camera*>                  m_camera_mailbox;       // most recent camera not applied yet, if any
+    std::atomic<bool>                               m_camera_change_folded; // restart once the current pass is displayed
+    std::atomic<Clock::rep>                         m_pass_duration;        // time to display the first pass after the last restart
+    std::atomic<Clock::rep>                         m_last_update_time;
+    std::atomic<bool>                               m_navigating;
+    std::atomic<Clock::rep>                         m_last_camera_change;
+
+    // Only accessed from the rendering thread.
+    size_t                                          m_divisor;              // divisor of the resolution of the current frame
+    size_t                                          m_navigation_divisor;   // divisor of the resolution while the camera moves
+    Clock::time_point                               m_rendering_begin_time;
+    bool                                            m_first_update_received;
+
+    // Request a restart unless rendering is already being stopped or restarted.
+    void restart_rendering();
+
+    void set_resolution_divisor(const size_t divisor);
 };
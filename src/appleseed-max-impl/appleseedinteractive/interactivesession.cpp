@@ -31,10 +31,19 @@
 
 // appleseed-max headers.
 #include "appleseedinteractive/interactivetilecallback.h"
+#include "utilities.h"
 
 // appleseed.renderer headers.
+#include "renderer/api/log.h"
 #include "renderer/api/project.h"
 #include "renderer/api/rendering.h"
+#include "renderer/api/scene.h"
+
+// appleseed.foundation headers.
+#include "foundation/utility/string.h"
+
+// Standard headers.
+#include <utility>
 
 namespace asf = foundation;
 namespace asr = renderer;
@@ -48,32 +57,44 @@ InteractiveSession::InteractiveSession(
   , m_iirender_mgr(iirender_mgr)
   , m_renderer_settings(settings)
   , m_bitmap(bitmap)
-  , m_render_ctrl(nullptr)
 {
+    // Frame rate to maintain while navigating, zero to always render at full resolution.
+    const int target_frame_rate = load_system_setting(L"ActiveShadeNavigationFrameRate", 15);
+    m_target_frame_time =
+        std::chrono::milliseconds(target_frame_rate > 0 ? 1000 / target_frame_rate : 0);
 }
 
-void InteractiveSession::render_thread()
+InteractiveSession::~InteractiveSession()
 {
-    // Create the renderer controller.
-    m_render_ctrl.reset(new InteractiveRendererController());
+}
 
-    // Create the tile callback.
-    InteractiveTileCallback m_tile_callback(m_bitmap, m_iirender_mgr, m_render_ctrl.get());
+void InteractiveSession::render_thread()
+{
+    if (m_renderer == nullptr)
+    {
+        // Create the tile callback.
+        m_tile_callback.reset(new InteractiveTileCallback(m_bitmap, m_iirender_mgr, m_render_ctrl.get()));
 
-    // Create the master renderer.
-    std::auto_ptr<asr::MasterRenderer> renderer(
-        new asr::MasterRenderer(
-            *m_project,
-            m_project->configurations().get_by_name("interactive")->get_inherited_parameters(),
-            m_render_ctrl.get(),
-            &m_tile_callback));
+        // Create the master renderer.
+        m_renderer.reset(
+            new asr::MasterRenderer(
+                *m_project,
+                m_project->configurations().get_by_name("interactive")->get_inherited_parameters(),
+                m_render_ctrl.get(),
+                m_tile_callback.get()));
+    }
 
     // Render the frame.
-    renderer->render();
+    m_renderer->render();
 }
 
 void InteractiveSession::start_render()
 {
+    // Create the renderer controller before starting the rendering thread, since updates
+    // may be scheduled from the UI thread as soon as this returns.
+    if (m_render_ctrl == nullptr)
+        m_render_ctrl.reset(new InteractiveRendererController(*m_project, m_target_frame_time));
+
     m_render_thread = std::thread(&InteractiveSession::render_thread, this);
 }
 
@@ -91,11 +112,37 @@ void InteractiveSession::end_render()
 {
     if (m_render_thread.joinable())
         m_render_thread.join();
+
+    if (m_render_ctrl != nullptr)
+    {
+        const InteractiveRendererController::Statistics stats = m_render_ctrl->get_statistics();
+        RENDERER_LOG_INFO(
+            "scheduled updates: %s scheduled, %s coalesced, %s applied in %s, maximum queue depth %s.",
+            asf::pretty_uint(stats.m_scheduled_count).c_str(),
+            asf::pretty_uint(stats.m_coalesced_count).c_str(),
+            asf::pretty_uint(stats.m_applied_count).c_str(),
+            asf::pretty_time(stats.m_apply_time).c_str(),
+            asf::pretty_uint(stats.m_max_queue_depth).c_str());
+    }
 }
 
 void InteractiveSession::schedule_camera_update(
     asf::auto_release_ptr<asr::Camera>  camera)
+{
+    m_render_ctrl->post_camera(camera);
+}
+
+void InteractiveSession::schedule_material_update(
+    asr::Assembly&                          assembly,
+    const std::string&                      material_name,
+    asf::auto_release_ptr<asr::Assembly>    staging_assembly)
 {
     m_render_ctrl->schedule_update(
-        std::unique_ptr<ScheduledAction>(new CameraObjectUpdateAction(*m_project, camera)));
+        std::unique_ptr<ScheduledAction>(new MaterialUpdateAction(assembly, material_name, staging_assembly)));
+}
+
+void InteractiveSession::schedule_transform_update(
+    std::unique_ptr<TransformUpdateAction>  action)
+{
+    m_render_ctrl->schedule_update(std::move(action));
 }
@@ -36,14 +36,24 @@
 #include "foundation/utility/autoreleaseptr.h"
 
 // Standard headers.
+#include <chrono>
 #include <memory>
+#include <string>
 #include <thread>
 
 // Forward declarations.
+namespace renderer { class Assembly; }
 namespace renderer { class Camera; }
+namespace renderer { class MasterRenderer; }
 namespace renderer { class Project; }
 class Bitmap;
 class IIRenderMgr;
+class InteractiveTileCallback;
+
+//
+// The renderer of a session is kept when rendering ends, so that rendering can
+// be started again without rebuilding the scene and the rendering components.
+//
 
 class InteractiveSession
 {
@@ -54,6 +64,8 @@ class InteractiveSession
         const RendererSettings&     settings,
         Bitmap*                     bitmap);
 
+    ~InteractiveSession();
+
     void start_render();
     void abort_render();
     void reininitialize_render();
@@ -62,13 +74,24 @@ class InteractiveSession
     void schedule_camera_update(
         foundation::auto_release_ptr<renderer::Camera>  camera);
 
+    void schedule_material_update(
+        renderer::Assembly&                                 assembly,
+        const std::string&                                  material_name,
+        foundation::auto_release_ptr<renderer::Assembly>    staging_assembly);
+
+    void schedule_transform_update(
+        std::unique_ptr<TransformUpdateAction>              action);
+
   private:
     std::unique_ptr<InteractiveRendererController>  m_render_ctrl;
+    std::unique_ptr<InteractiveTileCallback>        m_tile_callback;
+    std::unique_ptr<renderer::MasterRenderer>       m_renderer;
     std::thread                                     m_render_thread;
     Bitmap*                                         m_bitmap;
     IIRenderMgr*                                    m_iirender_mgr;
     renderer::Project*                              m_project;
     RendererSettings                                m_renderer_settings;
+    std::chrono::milliseconds                       m_target_frame_time;
 
     void render_thread();
 };
@@ -29,11 +29,33 @@
 // Interface header.
 #include "interactivetilecallback.h"
 
+// appleseed-max headers.
+#include "appleseedinteractive/interactiverenderercontroller.h"
+
+// appleseed.renderer headers.
+#include "renderer/api/frame.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/canvasproperties.h"
+#include "foundation/image/image.h"
+#include "foundation/image/pixel.h"
+#include "foundation/image/tile.h"
+
 // 3ds Max headers.
+#include <assert1.h>
 #include <bitmap.h>
 #include <interactiverender.h>
 #include <maxapi.h>
 
+// Standard headers.
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace asf = foundation;
 namespace asr = renderer;
 
 namespace
@@ -41,41 +63,219 @@ namespace
     const UINT WM_TRIGGER_CALLBACK = WM_USER + 4764;
 }
 
+
+//
+// A triple-buffered copy of the frame, written by the rendering thread and displayed by the UI thread.
+//
+// The rendering thread fills the back buffer and publishes it by exchanging it with the ready buffer.
+// The UI thread takes the ready buffer, if a new one was published, by exchanging it with the front
+// buffer. Neither thread ever waits for the other, and the UI thread always displays the latest
+// complete frame. Frames rendered at reduced resolution are upscaled to the size of the bitmap.
+//
+
+class DisplaySurface
+{
+  public:
+    DisplaySurface(
+        Bitmap*                     bitmap,
+        IIRenderMgr*                iimanager)
+      : m_bitmap(bitmap)
+      , m_iimanager(iimanager)
+      , m_back(0)
+      , m_ready(1)
+      , m_front(2)
+      , m_present_pending(false)
+    {
+    }
+
+    // Copy a frame to the back buffer and publish it. Called from the rendering thread.
+    // Return true if the UI thread must be notified.
+    bool publish(const asr::Frame& frame)
+    {
+        const asf::Image& image = frame.image();
+        const asf::CanvasProperties& props = image.properties();
+
+        DbgAssert(props.m_channel_count == 4);
+
+        Buffer& buffer = m_buffers[m_back];
+        buffer.m_width = props.m_canvas_width;
+        buffer.m_height = props.m_canvas_height;
+        buffer.m_pixels.resize(props.m_pixel_count);
+
+        if (m_float_tile_storage.get() == nullptr)
+        {
+            m_float_tile_storage.reset(
+                new asf::Tile(
+                    props.m_tile_width,
+                    props.m_tile_height,
+                    props.m_channel_count,
+                    asf::PixelFormatFloat));
+        }
+
+        for (size_t tile_y = 0; tile_y < props.m_tile_count_y; ++tile_y)
+        {
+            for (size_t tile_x = 0; tile_x < props.m_tile_count_x; ++tile_x)
+            {
+                // Convert the tile to 32-bit floating point.
+                const asf::Tile& tile = image.tile(tile_x, tile_y);
+                asf::Tile fp_tile(
+                    tile,
+                    asf::PixelFormatFloat,
+                    m_float_tile_storage->get_storage());
+
+                const size_t x = tile_x * props.m_tile_width;
+                const size_t y = tile_y * props.m_tile_height;
+                for (size_t row = 0, e = fp_tile.get_height(); row < e; ++row)
+                {
+                    std::memcpy(
+                        &buffer.m_pixels[(y + row) * buffer.m_width + x],
+                        fp_tile.pixel(0, row),
+                        fp_tile.get_width() * sizeof(BMM_Color_fl));
+                }
+            }
+        }
+
+        m_back = m_ready.exchange(m_back | NewBufferFlag) & BufferIndexMask;
+
+        return !m_present_pending.exchange(true);
+    }
+
+    // Allow a new notification after a notification failed to be posted.
+    void cancel_present()
+    {
+        m_present_pending = false;
+    }
+
+    // Display the latest published buffer. Called from the UI thread.
+    void present()
+    {
+        // Buffers published from now on require a new notification.
+        m_present_pending = false;
+
+        if ((m_ready.load() & NewBufferFlag) == 0)
+            return;
+
+        m_front = m_ready.exchange(m_front) & BufferIndexMask;
+
+        if (!m_iimanager->IsRendering())
+            return;
+
+        const Buffer& buffer = m_buffers[m_front];
+        const size_t width = static_cast<size_t>(m_bitmap->Width());
+        const size_t height = static_cast<size_t>(m_bitmap->Height());
+
+        if (buffer.m_width == width && buffer.m_height == height)
+        {
+            for (size_t y = 0; y < height; ++y)
+            {
+                m_bitmap->PutPixels(
+                    0,
+                    static_cast<int>(y),
+                    static_cast<int>(width),
+                    const_cast<BMM_Color_fl*>(&buffer.m_pixels[y * width]));
+            }
+        }
+        else if (buffer.m_width > 0 && buffer.m_height > 0)
+        {
+            // Upscale with nearest neighbor filtering, reusing rows that map to the same source row.
+            m_row.resize(width);
+            size_t previous_src_y = ~size_t(0);
+            for (size_t y = 0; y < height; ++y)
+            {
+                const size_t src_y = std::min(y * buffer.m_height / height, buffer.m_height - 1);
+                if (src_y != previous_src_y)
+                {
+                    const BMM_Color_fl* src_row = &buffer.m_pixels[src_y * buffer.m_width];
+                    for (size_t x = 0; x < width; ++x)
+                        m_row[x] = src_row[std::min(x * buffer.m_width / width, buffer.m_width - 1)];
+                    previous_src_y = src_y;
+                }
+
+                m_bitmap->PutPixels(0, static_cast<int>(y), static_cast<int>(width), m_row.data());
+            }
+        }
+
+        m_iimanager->UpdateDisplay();
+    }
+
+  private:
+    static_assert(
+        sizeof(BMM_Color_fl) == 4 * sizeof(float),
+        "BMM_Color_fl is expected to be made of four floats");
+
+    struct Buffer
+    {
+        Buffer()
+          : m_width(0)
+          , m_height(0)
+        {
+        }
+
+        size_t                      m_width;
+        size_t                      m_height;
+        std::vector<BMM_Color_fl>   m_pixels;
+    };
+
+    static const size_t NewBufferFlag = 4;
+    static const size_t BufferIndexMask = 3;
+
+    Bitmap*                         m_bitmap;
+    IIRenderMgr*                    m_iimanager;
+    Buffer                          m_buffers[3];
+    size_t                          m_back;                 // only accessed by the rendering thread
+    std::atomic<size_t>             m_ready;                // index of the ready buffer, with NewBufferFlag if it was never displayed
+    size_t                          m_front;                // only accessed by the UI thread
+    std::atomic<bool>               m_present_pending;      // a notification was posted to the UI thread and not handled yet
+    std::unique_ptr<asf::Tile>      m_float_tile_storage;   // only accessed by the rendering thread
+    std::vector<BMM_Color_fl>       m_row;                  // only accessed by the UI thread
+};
+
+
+//
+// InteractiveTileCallback class implementation.
+//
+
 InteractiveTileCallback::InteractiveTileCallback(
-    Bitmap*                     bitmap,
-    IIRenderMgr*                iimanager,
-    asr::IRendererController*   render_controller)
+    Bitmap*                         bitmap,
+    IIRenderMgr*                    iimanager,
+    InteractiveRendererController*  render_controller)
   : TileCallback(bitmap, nullptr)
-  , m_bitmap(bitmap)
-  , m_iimanager(iimanager)
   , m_renderer_ctrl(render_controller)
+  , m_display_surface(new DisplaySurface(bitmap, iimanager))
 {
 }
 
 void InteractiveTileCallback::on_progressive_frame_update(
-    const asr::Frame*           frame)
+    const asr::Frame*               frame)
 {
-    TileCallback::on_progressive_frame_update(frame);
+    if (m_renderer_ctrl->get_status() != asr::IRendererController::ContinueRendering)
+        return;
+
+    m_renderer_ctrl->on_frame_update();
 
-    // Wait until UI proc gets handled to ensure class object is valid.
-    m_ui_promise = std::promise<void>();
-    if (m_renderer_ctrl->get_status() == asr::IRendererController::ContinueRendering)
+    // Hand the frame over to the UI thread without waiting for it to be displayed. At most one
+    // notification is in flight at a time; it refers to the display surface through a weak pointer
+    // since this callback may be gone by the time the notification is handled.
+    if (m_display_surface->publish(*frame))
     {
-        PostMessage(
-            GetCOREInterface()->GetMAXHWnd(),
-            WM_TRIGGER_CALLBACK,
-            reinterpret_cast<UINT_PTR>(update_caller),
-            reinterpret_cast<UINT_PTR>(this));
-        m_ui_promise.get_future().wait();
+        std::unique_ptr<std::weak_ptr<DisplaySurface>> weak_surface(
+            new std::weak_ptr<DisplaySurface>(m_display_surface));
+
+        if (PostMessage(
+                GetCOREInterface()->GetMAXHWnd(),
+                WM_TRIGGER_CALLBACK,
+                reinterpret_cast<UINT_PTR>(update_caller),
+                reinterpret_cast<UINT_PTR>(weak_surface.get())))
+            weak_surface.release();
+        else m_display_surface->cancel_present();
     }
 }
 
 void InteractiveTileCallback::update_caller(UINT_PTR param_ptr)
 {
-    auto tile_callback = reinterpret_cast<InteractiveTileCallback*>(param_ptr);
-    
-    if (tile_callback->m_iimanager->IsRendering())
-        tile_callback->m_iimanager->UpdateDisplay();
+    std::unique_ptr<std::weak_ptr<DisplaySurface>> weak_surface(
+        reinterpret_cast<std::weak_ptr<DisplaySurface>*>(param_ptr));
 
-    tile_callback->m_ui_promise.set_value();
+    if (std::shared_ptr<DisplaySurface> surface = weak_surface->lock())
+        surface->present();
 }
@@ -36,13 +36,14 @@
 #include "foundation/platform/windows.h"
 
 // Standard headers.
-#include <future>
+#include <memory>
 
 // Forward declarations.
 namespace renderer  { class Frame; }
-namespace renderer  { class IRendererController; }
 class Bitmap;
+class DisplaySurface;
 class IIRenderMgr;
+class InteractiveRendererController;
 
 class InteractiveTileCallback
   : public TileCallback
@@ -51,15 +52,13 @@ class InteractiveTileCallback
     InteractiveTileCallback(
         Bitmap*                         bitmap,
         IIRenderMgr*                    iimanager,
-        renderer::IRendererController*  render_controller);
+        InteractiveRendererController*  render_controller);
 
     void on_progressive_frame_update(const renderer::Frame* frame) override;
 
   private:
-    Bitmap*                             m_bitmap;
-    IIRenderMgr*                        m_iimanager;
-    renderer::IRendererController*      m_renderer_ctrl;
-    std::promise<void>                  m_ui_promise;
+    InteractiveRendererController*      m_renderer_ctrl;
+    std::shared_ptr<DisplaySurface>     m_display_surface;
 
     static void update_caller(UINT_PTR param_ptr);
 };
@@ -548,7 +548,7 @@ asf::auto_release_ptr<asr::Material> OSLMaterial::create_osl_material(
         closure_2_surface_name.c_str(),
         "in_input");
 
-    assembly.shader_groups().insert(shader_group);
+    shader_group_name = insert_shader_group(assembly, shader_group);
 
     //
     // Material.
@@ -37,21 +37,25 @@
 #include "appleseedrenderer/dialoglogtarget.h"
 #include "appleseedrenderer/projectbuilder.h"
 #include "appleseedrenderer/renderercontroller.h"
+#include "appleseedrenderer/textureconverter.h"
 #include "appleseedrenderer/tilecallback.h"
 #include "utilities.h"
 #include "version.h"
 
 // appleseed.renderer headers.
 #include "renderer/api/frame.h"
+#include "renderer/api/log.h"
 #include "renderer/api/project.h"
 #include "renderer/api/rendering.h"
 
 // appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
 #include "foundation/image/canvasproperties.h"
 #include "foundation/image/image.h"
 #include "foundation/platform/thread.h"
 #include "foundation/platform/types.h"
 #include "foundation/utility/autoreleaseptr.h"
+#include "foundation/utility/string.h"
 
 // 3ds Max headers.
 #include <assert1.h>
@@ -127,6 +131,30 @@ namespace
             this->first_field = true;
         }
     };
+
+    // Give the objects lent to a project back to the geometry cache when going out of scope.
+    class GeometryCacheReclaimer
+      : public asf::NonCopyable
+    {
+      public:
+        GeometryCacheReclaimer(
+            GeometryCache*      geometry_cache,
+            asr::Project*       project)
+          : m_geometry_cache(geometry_cache)
+          , m_project(project)
+        {
+        }
+
+        ~GeometryCacheReclaimer()
+        {
+            if (m_geometry_cache != nullptr)
+                m_geometry_cache->reclaim(m_project);
+        }
+
+      private:
+        GeometryCache*  m_geometry_cache;
+        asr::Project*   m_project;
+    };
 }
 
 AppleseedRendererClassDesc g_appleseed_renderer_classdesc;
@@ -526,11 +554,25 @@ int AppleseedRenderer::Render(
         progress_cb->SetTitle(L"Collecting Entities...");
     m_entities.clear();
     MaxSceneEntityCollector collector(m_entities);
-    collector.collect(m_scene);
+    collector.collect(m_scene, m_time);
 
     // Call RenderBegin() on all object instances.
     render_begin(m_entities.m_objects, m_time);
 
+    // Geometry converted for previous renders is reused unless the cache is disabled.
+    // Material previews don't use the cache.
+    GeometryCache* geometry_cache = nullptr;
+    if (!m_rend_params.inMtlEdit)
+    {
+        if (m_settings.m_geometry_cache_size > 0)
+        {
+            m_geometry_cache.set_memory_budget(static_cast<size_t>(m_settings.m_geometry_cache_size) * 1024 * 1024);
+            m_geometry_cache.remove_deleted_nodes();
+            geometry_cache = &m_geometry_cache;
+        }
+        else m_geometry_cache.clear();
+    }
+
     // Build the project.
     if (progress_cb)
         progress_cb->SetTitle(L"Building Project...");
@@ -543,10 +585,27 @@ int AppleseedRenderer::Render(
             m_rend_params,
             frame_rend_params,
             renderer_settings,
+            geometry_cache,
+            m_rend_params.inMtlEdit ? nullptr : &m_envmap_cache,
+            nullptr,
+            nullptr,
             bitmap,
             time,
             progress_cb));
 
+    // The project must not be destroyed before the geometry cache took its objects back.
+    GeometryCacheReclaimer geometry_cache_reclaimer(geometry_cache, project.get());
+
+    if (geometry_cache != nullptr)
+    {
+        RENDERER_LOG_INFO(
+            "geometry cache: %s hit(s), %s miss(es), %s in use.",
+            asf::pretty_uint(geometry_cache->get_hit_count()).c_str(),
+            asf::pretty_uint(geometry_cache->get_miss_count()).c_str(),
+            asf::pretty_size(geometry_cache->get_memory_size()).c_str());
+        geometry_cache->reset_statistics();
+    }
+
     if (m_rend_params.inMtlEdit)
     {
         // Write the project to disk, useful to debug material previews.
@@ -577,6 +636,21 @@ int AppleseedRenderer::Render(
         if (m_settings.m_output_mode == RendererSettings::OutputMode::RenderOnly ||
             m_settings.m_output_mode == RendererSettings::OutputMode::SaveProjectAndRender)
         {
+            // Convert bitmap textures to tiled, mipmapped files. This happens after the project
+            // was written to disk so that project files keep referencing the original files.
+            if (load_system_setting(L"ConvertTextures", false))
+            {
+                if (progress_cb)
+                    progress_cb->SetTitle(L"Converting Textures...");
+                if (!convert_project_textures(
+                        project.ref(),
+                        TextureConversionSettings::load(get_thread_count(m_settings.m_rendering_threads)),
+                        progress_cb))
+                {
+                    std::setlocale(LC_ALL, previous_locale.c_str());
+                    return 1;
+                }
+            }
 
             AppleseedRenderContext render_context(
                 static_cast<Renderer*>(this), 
@@ -29,6 +29,8 @@
 #pragma once
 
 // appleseed-max headers.
+#include "appleseedrenderer/environmentmapcache.h"
+#include "appleseedrenderer/geometrycache.h"
 #include "appleseedrenderer/maxsceneentities.h"
 #include "appleseedrenderer/renderersettings.h"
 
@@ -156,6 +158,8 @@ class AppleseedRenderer
     std::vector<DefaultLight>   m_default_lights;
     TimeValue                   m_time;
     MaxSceneEntities            m_entities;
+    GeometryCache               m_geometry_cache;
+    EnvironmentMapCache         m_envmap_cache;
 
     void clear();
 };
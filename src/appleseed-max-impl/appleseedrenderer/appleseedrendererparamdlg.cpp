@@ -435,6 +435,8 @@ namespace
         ISpinnerControl*        m_spinner_max_ray_intensity;
         ICustEdit*              m_text_background_alpha;
         ISpinnerControl*        m_spinner_background_alpha;
+        ICustEdit*              m_text_envmap_resolution;
+        ISpinnerControl*        m_spinner_envmap_resolution;
 
         LightingPanel(
             IRendParams*        rend_params,
@@ -453,6 +455,8 @@ namespace
 
         ~LightingPanel() override
         {
+            ReleaseISpinner(m_spinner_envmap_resolution);
+            ReleaseICustEdit(m_text_envmap_resolution);
             ReleaseISpinner(m_spinner_background_alpha);
             ReleaseICustEdit(m_text_background_alpha);
             ReleaseISpinner(m_spinner_bounces);
@@ -498,6 +502,14 @@ namespace
             CheckDlgButton(hwnd, IDC_CHECK_FORCE_OFF_DEFAULT_LIGHT,
                 m_settings.m_force_off_default_lights ? BST_CHECKED : BST_UNCHECKED);
 
+            // A resolution of zero derives the resolution from the output resolution.
+            m_text_envmap_resolution = GetICustEdit(GetDlgItem(hwnd, IDC_TEXT_ENVMAP_RESOLUTION));
+            m_spinner_envmap_resolution = GetISpinner(GetDlgItem(hwnd, IDC_SPINNER_ENVMAP_RESOLUTION));
+            m_spinner_envmap_resolution->LinkToEdit(GetDlgItem(hwnd, IDC_TEXT_ENVMAP_RESOLUTION), EDITTYPE_POS_INT);
+            m_spinner_envmap_resolution->SetLimits(0, 8192, FALSE);
+            m_spinner_envmap_resolution->SetResetValue(RendererSettings::defaults().m_envmap_resolution);
+            m_spinner_envmap_resolution->SetValue(m_settings.m_envmap_resolution, FALSE);
+
             enable_disable_controls();
         }
 
@@ -568,6 +580,10 @@ namespace
                     m_settings.m_background_alpha = m_spinner_background_alpha->GetFVal();
                     return TRUE;
 
+                  case IDC_SPINNER_ENVMAP_RESOLUTION:
+                    m_settings.m_envmap_resolution = m_spinner_envmap_resolution->GetIVal();
+                    return TRUE;
+
                   default:
                     return FALSE;
                 }
@@ -752,6 +768,8 @@ namespace
         ICustEdit*              m_text_renderingthreads;
         ISpinnerControl*        m_spinner_renderingthreads;
         ICustEdit*              m_text_render_stamp;
+        ICustEdit*              m_text_geometry_cache_size;
+        ISpinnerControl*        m_spinner_geometry_cache_size;
         AppleseedRenderer*      m_renderer;
         OutputPanel*            m_output_panel;
 
@@ -776,6 +794,8 @@ namespace
 
         ~SystemPanel() override
         {
+            ReleaseISpinner(m_spinner_geometry_cache_size);
+            ReleaseICustEdit(m_text_geometry_cache_size);
             ReleaseISpinner(m_spinner_renderingthreads);
             ReleaseICustEdit(m_text_renderingthreads);
             ReleaseICustEdit(m_text_render_stamp);
@@ -804,6 +824,14 @@ namespace
             m_text_render_stamp = GetICustEdit(GetDlgItem(hwnd, IDC_TEXT_RENDER_STAMP));
             m_text_render_stamp->SetText(m_settings.m_render_stamp_format);
 
+            // A size of zero disables the geometry cache.
+            m_text_geometry_cache_size = GetICustEdit(GetDlgItem(hwnd, IDC_TEXT_GEOMETRY_CACHE_SIZE));
+            m_spinner_geometry_cache_size = GetISpinner(GetDlgItem(hwnd, IDC_SPINNER_GEOMETRY_CACHE_SIZE));
+            m_spinner_geometry_cache_size->LinkToEdit(GetDlgItem(hwnd, IDC_TEXT_GEOMETRY_CACHE_SIZE), EDITTYPE_POS_INT);
+            m_spinner_geometry_cache_size->SetLimits(0, 65536, FALSE);
+            m_spinner_geometry_cache_size->SetResetValue(RendererSettings::defaults().m_geometry_cache_size);
+            m_spinner_geometry_cache_size->SetValue(m_settings.m_geometry_cache_size, FALSE);
+
             enable_disable_controls();
         }
 
@@ -881,6 +909,10 @@ namespace
                     m_settings.m_rendering_threads = m_spinner_renderingthreads->GetIVal();
                     return TRUE;
 
+                  case IDC_SPINNER_GEOMETRY_CACHE_SIZE:
+                    m_settings.m_geometry_cache_size = m_spinner_geometry_cache_size->GetIVal();
+                    return TRUE;
+
                   default:
                     return FALSE;
                 }
@@ -56,6 +56,7 @@ const USHORT ChunkSettingsLightingMaxRayIntensity       = 0x1250;
 const USHORT ChunkSettingsLightingBackgroundEmitsLight  = 0x1230;
 const USHORT ChunkSettingsLightingBackgroundAlpha       = 0x1260;
 const USHORT ChunkSettingsLightingForceOffDefaultLights = 0x1270;
+const USHORT ChunkSettingsLightingEnvMapResolution      = 0x1280;
 
 const USHORT ChunkSettingsOutput                        = 0x1300;
 const USHORT ChunkSettingsOutputMode                    = 0x1310;
@@ -68,3 +69,4 @@ const USHORT ChunkSettingsSystemLowPriorityMode         = 0x1420;
 const USHORT ChunkSettingsSystemUseMaxProceduralMaps    = 0x1430;
 const USHORT ChunkSettingsSystemEnableRenderStamp       = 0x1440;
 const USHORT ChunkSettingsSystemRenderStampString       = 0x1450;
+const USHORT ChunkSettingsSystemGeometryCacheSize       = 0x1460;
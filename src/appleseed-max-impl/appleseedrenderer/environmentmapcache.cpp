@@ -0,0 +1,143 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2018 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "environmentmapcache.h"
+
+// appleseed.renderer headers.
+#include "renderer/api/source.h"
+#include "renderer/api/texture.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/canvasproperties.h"
+#include "foundation/image/colorspace.h"
+#include "foundation/image/tile.h"
+
+namespace asf = foundation;
+namespace asr = renderer;
+
+namespace
+{
+    class SharedImageTexture
+      : public asr::Texture
+    {
+      public:
+        SharedImageTexture(
+            const char*                             name,
+            const EnvironmentMapCache::ImagePtr&    image)
+          : asr::Texture(name, asr::ParamArray())
+          , m_image(image)
+        {
+        }
+
+        void release() override
+        {
+            delete this;
+        }
+
+        const char* get_model() const override
+        {
+            return "shared_image_texture";
+        }
+
+        asf::ColorSpace get_color_space() const override
+        {
+            return asf::ColorSpaceLinearRGB;
+        }
+
+        const asf::CanvasProperties& properties() override
+        {
+            return m_image->properties();
+        }
+
+        asr::Source* create_source(
+            const asf::UniqueID         assembly_uid,
+            const asr::TextureInstance& texture_instance) override
+        {
+            return new asr::TextureSource(assembly_uid, texture_instance);
+        }
+
+        // Tiles are served straight from the shared image.
+        asf::Tile* load_tile(
+            const size_t                tile_x,
+            const size_t                tile_y) override
+        {
+            return &m_image->tile(tile_x, tile_y);
+        }
+
+        void unload_tile(
+            const size_t                tile_x,
+            const size_t                tile_y,
+            const asf::Tile*            tile) override
+        {
+        }
+
+      private:
+        const EnvironmentMapCache::ImagePtr m_image;
+    };
+}
+
+EnvironmentMapCache::ImagePtr EnvironmentMapCache::lookup(
+    const asf::uint64       signature,
+    const size_t            width,
+    const size_t            height) const
+{
+    if (!m_image || m_signature != signature)
+        return ImagePtr();
+
+    const asf::CanvasProperties& props = m_image->properties();
+    if (props.m_canvas_width != width || props.m_canvas_height != height)
+        return ImagePtr();
+
+    return m_image;
+}
+
+void EnvironmentMapCache::insert(
+    const asf::uint64       signature,
+    const ImagePtr&         image)
+{
+    m_signature = signature;
+    m_image = image;
+}
+
+void EnvironmentMapCache::clear()
+{
+    m_image.reset();
+}
+
+EnvironmentMapCache::ImagePtr make_shared_image(asf::auto_release_ptr<asf::Image> image)
+{
+    return EnvironmentMapCache::ImagePtr(image.release(), [](asf::Image* image) { image->release(); });
+}
+
+asf::auto_release_ptr<asr::Texture> create_shared_image_texture(
+    const char*                             name,
+    const EnvironmentMapCache::ImagePtr&    image)
+{
+    return asf::auto_release_ptr<asr::Texture>(new SharedImageTexture(name, image));
+}
@@ -0,0 +1,85 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2018 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/image/image.h"
+#include "foundation/platform/types.h"
+#include "foundation/utility/autoreleaseptr.h"
+
+// Standard headers.
+#include <cstddef>
+#include <memory>
+
+// Forward declarations.
+namespace renderer  { class Texture; }
+
+//
+// A cache of the environment map baked for the last render.
+//
+// Non-bitmap environment maps are rendered to an image before each render. The image
+// is kept along with a signature of the texture map it was rendered from, computed by
+// the caller, so that repeat renders with the same environment can reuse it. The image
+// is shared with the textures created from it rather than copied.
+//
+
+class EnvironmentMapCache
+  : public foundation::NonCopyable
+{
+  public:
+    typedef std::shared_ptr<foundation::Image> ImagePtr;
+
+    // Return the image previously baked from a texture map with a given signature
+    // at a given resolution, or nullptr if there is none.
+    ImagePtr lookup(
+        const foundation::uint64    signature,
+        const size_t                width,
+        const size_t                height) const;
+
+    // Store the image baked from a texture map with a given signature.
+    void insert(
+        const foundation::uint64    signature,
+        const ImagePtr&             image);
+
+    // Remove the stored image, if any.
+    void clear();
+
+  private:
+    foundation::uint64              m_signature;
+    ImagePtr                        m_image;
+};
+
+// Take ownership of an image so that it can be shared.
+EnvironmentMapCache::ImagePtr make_shared_image(foundation::auto_release_ptr<foundation::Image> image);
+
+// Create a linear RGB texture that reads its texels from a shared image.
+foundation::auto_release_ptr<renderer::Texture> create_shared_image_texture(
+    const char*                             name,
+    const EnvironmentMapCache::ImagePtr&    image);
@@ -0,0 +1,308 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2018 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "geometrycache.h"
+
+// appleseed-max headers.
+#include "appleseedrenderer/meshoptimizer.h"
+
+// appleseed.renderer headers.
+#include "renderer/api/project.h"
+#include "renderer/api/scene.h"
+
+// 3ds Max headers.
+#include <maxapi.h>
+
+// Standard headers.
+#include <algorithm>
+
+namespace asf = foundation;
+namespace asr = renderer;
+
+namespace
+{
+    typedef std::vector<std::pair<asr::ObjectContainer*, asr::Object*>> ObjectVector;
+
+    // Collect the objects of an assembly and of its child assemblies.
+    void collect_objects(
+        asr::Assembly&          assembly,
+        ObjectVector&           objects)
+    {
+        for (asr::Object& object : assembly.objects())
+            objects.push_back(std::make_pair(&assembly.objects(), &object));
+
+        for (asr::Assembly& child_assembly : assembly.assemblies())
+            collect_objects(child_assembly, objects);
+    }
+}
+
+GeometryCache::GeometryCache(const size_t memory_budget)
+  : m_memory_budget(memory_budget)
+  , m_memory_size(0)
+  , m_hit_count(0)
+  , m_miss_count(0)
+{
+}
+
+void GeometryCache::set_memory_budget(const size_t memory_budget)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_memory_budget = memory_budget;
+    evict();
+}
+
+bool GeometryCache::lookup(
+    const Key&              key,
+    const TimeValue         time,
+    const asf::uint64       source_signature,
+    const char*             name,
+    asr::MeshObject&        object,
+    CachedGeometry&         geometry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto reference_it = m_references.find(key);
+    if (reference_it == m_references.end() ||
+        !reference_it->second.m_validity.InInterval(time) ||
+        reference_it->second.m_source_signature != source_signature)
+    {
+        ++m_miss_count;
+        return false;
+    }
+
+    const asf::uint64 content_hash = reference_it->second.m_content_hash;
+    StoredGeometry& stored = m_storage.find(content_hash)->second;
+
+    if (stored.m_object.get() != nullptr)
+    {
+        // Lend the stored object.
+        stored.m_lent_object = stored.m_object.get();
+        stored.m_object->set_name(name);
+        m_lent_objects[stored.m_object->get_uid()] = content_hash;
+        geometry.m_object.reset(stored.m_object.release());
+    }
+    else
+    {
+        // The stored object is already lent, share its geometry with this render mesh.
+        copy_mesh(*stored.m_lent_object, object);
+        m_lent_objects[object.get_uid()] = content_hash;
+    }
+
+    geometry.m_content_hash = content_hash;
+    geometry.m_mtlid_to_slot = stored.m_mtlid_to_slot;
+
+    // Mark the geometry as most recently used.
+    m_lru.splice(m_lru.begin(), m_lru, stored.m_lru_position);
+
+    ++m_hit_count;
+    return true;
+}
+
+void GeometryCache::insert(
+    const Key&                              key,
+    const Interval&                         validity,
+    const asf::uint64                       source_signature,
+    const asr::MeshObject&                  object,
+    const asf::uint64                       content_hash,
+    const std::map<MtlID, asf::uint32>&     mtlid_to_slot)
+{
+    const size_t memory_size = get_mesh_memory_size(object);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto storage_it = m_storage.find(content_hash);
+    if (storage_it != m_storage.end())
+    {
+        StoredGeometry& stored = storage_it->second;
+        const asr::MeshObject* stored_object =
+            stored.m_object.get() != nullptr ? stored.m_object.get() : stored.m_lent_object;
+        if (stored.m_mtlid_to_slot != mtlid_to_slot || !have_identical_meshes(*stored_object, object))
+        {
+            // Hash collision, don't cache this geometry.
+            return;
+        }
+
+        m_lru.splice(m_lru.begin(), m_lru, stored.m_lru_position);
+    }
+    else
+    {
+        m_lru.push_front(content_hash);
+
+        StoredGeometry& stored = m_storage[content_hash];
+        stored.m_lent_object = &object;
+        stored.m_mtlid_to_slot = mtlid_to_slot;
+        stored.m_memory_size = memory_size;
+        stored.m_lru_position = m_lru.begin();
+
+        m_memory_size += memory_size;
+    }
+
+    // Any object holding the geometry can be reclaimed, which matters if some of them get removed
+    // from the project, e.g. when objects with identical geometry are shared.
+    m_lent_objects[object.get_uid()] = content_hash;
+
+    const auto reference_it = m_references.find(key);
+    if (reference_it != m_references.end())
+        unlink_reference(key, reference_it->second.m_content_hash);
+
+    Reference& reference = m_references[key];
+    reference.m_validity = validity;
+    reference.m_source_signature = source_signature;
+    reference.m_content_hash = content_hash;
+    m_storage.find(content_hash)->second.m_keys.push_back(key);
+
+    evict();
+}
+
+void GeometryCache::reclaim(asr::Project* project)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_lent_objects.empty())
+        return;
+
+    if (project != nullptr && project->get_scene() != nullptr)
+    {
+        ObjectVector objects;
+        for (asr::Assembly& assembly : project->get_scene()->assemblies())
+            collect_objects(assembly, objects);
+
+        for (const auto& entry : objects)
+        {
+            const auto lent_it = m_lent_objects.find(entry.second->get_uid());
+            if (lent_it == m_lent_objects.end())
+                continue;
+
+            const auto storage_it = m_storage.find(lent_it->second);
+            if (storage_it == m_storage.end() || storage_it->second.m_object.get() != nullptr)
+                continue;
+
+            asf::auto_release_ptr<asr::Object> object = entry.first->remove(entry.second);
+            storage_it->second.m_object.reset(static_cast<asr::MeshObject*>(object.release()));
+        }
+    }
+
+    m_lent_objects.clear();
+
+    // Remove geometry whose objects were dropped from the project.
+    for (auto it = m_storage.begin(); it != m_storage.end(); )
+    {
+        it->second.m_lent_object = nullptr;
+
+        if (it->second.m_object.get() == nullptr)
+            remove_geometry(it++);
+        else ++it;
+    }
+}
+
+void GeometryCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_references.clear();
+    m_storage.clear();
+    m_lru.clear();
+    m_lent_objects.clear();
+    m_memory_size = 0;
+}
+
+void GeometryCache::remove_deleted_nodes()
+{
+    Interface* max_interface = GetCOREInterface();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_references.begin(); it != m_references.end(); )
+    {
+        if (max_interface->GetINodeByHandle(it->first.first) == nullptr)
+        {
+            unlink_reference(it->first, it->second.m_content_hash);
+            it = m_references.erase(it);
+        }
+        else ++it;
+    }
+
+    for (auto it = m_storage.begin(); it != m_storage.end(); )
+    {
+        if (it->second.m_keys.empty())
+            remove_geometry(it++);
+        else ++it;
+    }
+}
+
+size_t GeometryCache::get_memory_size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_memory_size;
+}
+
+size_t GeometryCache::get_hit_count() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hit_count;
+}
+
+size_t GeometryCache::get_miss_count() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_miss_count;
+}
+
+void GeometryCache::reset_statistics()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_hit_count = 0;
+    m_miss_count = 0;
+}
+
+void GeometryCache::unlink_reference(const Key& key, const asf::uint64 content_hash)
+{
+    std::vector<Key>& keys = m_storage.find(content_hash)->second.m_keys;
+    keys.erase(std::find(keys.begin(), keys.end(), key));
+}
+
+void GeometryCache::remove_geometry(const std::unordered_map<asf::uint64, StoredGeometry>::iterator it)
+{
+    // Forget about render meshes referencing this geometry.
+    for (const auto& key : it->second.m_keys)
+        m_references.erase(key);
+
+    // Objects lent to the project stay there.
+    m_memory_size -= it->second.m_memory_size;
+    m_lru.erase(it->second.m_lru_position);
+    m_storage.erase(it);
+}
+
+void GeometryCache::evict()
+{
+    while (m_memory_size > m_memory_budget && !m_lru.empty())
+        remove_geometry(m_storage.find(m_lru.back()));
+}
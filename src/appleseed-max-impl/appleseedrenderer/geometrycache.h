@@ -0,0 +1,171 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2018 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.renderer headers.
+#include "renderer/api/object.h"
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/platform/types.h"
+#include "foundation/platform/windows.h"    // include before 3ds Max headers
+#include "foundation/utility/autoreleaseptr.h"
+
+// 3ds Max headers.
+#include <interval.h>
+#include <maxtypes.h>
+
+// Standard headers.
+#include <cstddef>
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Forward declarations.
+namespace renderer  { class Project; }
+
+//
+// Geometry of a render mesh found in the cache.
+//
+
+struct CachedGeometry
+{
+    foundation::auto_release_ptr<renderer::MeshObject>  m_object;           // stored object, or null if its geometry was copied
+    foundation::uint64                                  m_content_hash;     // hash of the geometry of the object
+    std::map<MtlID, foundation::uint32>                 m_mtlid_to_slot;    // map a 3ds Max's material ID to an appleseed's material slot
+};
+
+//
+// A cache of converted geometry that persists across renders.
+//
+// Geometry is stored once per content hash of the converted arrays, so that identical meshes
+// share storage, and is evicted in least recently used order when the memory budget is exceeded.
+//
+// Render meshes of nodes are mapped to stored geometry. Such a mapping is only reused if the
+// render time lies in the validity interval of the object and if the 3ds Max mesh it was built
+// from has the same signature, a hash of its raw data computed by the caller.
+//
+// Geometry is stored as appleseed mesh objects which are lent to the project being built rather
+// than copied: lookup() hands stored objects over to the caller and insert() records objects
+// that the caller keeps in its project. Once the project is no longer rendered, reclaim() takes
+// these objects back from it. Stored geometry is thus only resident once, whether in use or not.
+//
+// All methods are thread-safe.
+//
+
+class GeometryCache
+  : public foundation::NonCopyable
+{
+  public:
+    // Identify a render mesh of a node.
+    typedef std::pair<ULONG, int> Key;     // node handle, render mesh index
+
+    explicit GeometryCache(const size_t memory_budget = 0);
+
+    // Set the maximum amount of memory used by stored geometry, in bytes.
+    void set_memory_budget(const size_t memory_budget);
+
+    // Look up the geometry previously stored for a given render mesh. Return false if there is
+    // none or if it is outdated. Otherwise, the stored object is renamed to `name` and handed over
+    // in `geometry.m_object`; the caller must insert it into the project being built. If the stored
+    // object is already used by that project, its geometry is copied to the empty object `object`
+    // and `geometry.m_object` is left null.
+    bool lookup(
+        const Key&                  key,
+        const TimeValue             time,
+        const foundation::uint64    source_signature,
+        const char*                 name,
+        renderer::MeshObject&       object,
+        CachedGeometry&             geometry);
+
+    // Store the geometry of a given render mesh. `object` must belong to the project being built;
+    // it is taken over by reclaim(). Nothing is stored if different geometry with the same content
+    // hash is already stored.
+    void insert(
+        const Key&                                  key,
+        const Interval&                             validity,
+        const foundation::uint64                    source_signature,
+        const renderer::MeshObject&                 object,
+        const foundation::uint64                    content_hash,
+        const std::map<MtlID, foundation::uint32>&  mtlid_to_slot);
+
+    // Take back the objects lent to a project. Must be called once the project is no longer
+    // rendered and before it is destroyed, or with nullptr if the project could not be built.
+    // Geometry whose objects are no longer part of the project is removed from the cache.
+    void reclaim(renderer::Project* project);
+
+    // Remove all geometry from the cache.
+    void clear();
+
+    // Forget about render meshes of deleted nodes and remove geometry no longer used by any node.
+    void remove_deleted_nodes();
+
+    // Return the amount of memory used by stored geometry, in bytes.
+    size_t get_memory_size() const;
+
+    // Return the number of hits and misses since the last call to reset_statistics().
+    size_t get_hit_count() const;
+    size_t get_miss_count() const;
+    void reset_statistics();
+
+  private:
+    struct Reference
+    {
+        Interval                m_validity;
+        foundation::uint64      m_source_signature;
+        foundation::uint64      m_content_hash;
+    };
+
+    struct StoredGeometry
+    {
+        foundation::auto_release_ptr<renderer::MeshObject>  m_object;           // null while lent
+        const renderer::MeshObject*                         m_lent_object;      // object lent to the project being built, if any
+        std::map<MtlID, foundation::uint32>                 m_mtlid_to_slot;
+        size_t                                              m_memory_size;
+        std::list<foundation::uint64>::iterator             m_lru_position;
+        std::vector<Key>                                    m_keys;             // render meshes referencing this geometry
+    };
+
+    mutable std::mutex                                          m_mutex;
+    size_t                                                      m_memory_budget;
+    size_t                                                      m_memory_size;
+    size_t                                                      m_hit_count;
+    size_t                                                      m_miss_count;
+    std::map<Key, Reference>                                    m_references;
+    std::unordered_map<foundation::uint64, StoredGeometry>      m_storage;
+    std::list<foundation::uint64>                               m_lru;              // most recently used first
+    std::unordered_map<foundation::uint64, foundation::uint64>  m_lent_objects;     // UIDs of objects lent to the project -> content hash
+
+    void unlink_reference(const Key& key, const foundation::uint64 content_hash);
+    void remove_geometry(const std::unordered_map<foundation::uint64, StoredGeometry>::iterator it);
+    void evict();
+};
@@ -29,13 +29,24 @@
 // Interface header.
 #include "maxsceneentities.h"
 
+// appleseed.renderer headers.
+#include "renderer/api/log.h"
+
 // appleseed.foundation headers.
+#include "foundation/platform/timers.h"
 #include "foundation/platform/windows.h"    // include before 3ds Max headers
 #include "foundation/utility/memory.h"
+#include "foundation/utility/stopwatch.h"
+#include "foundation/utility/string.h"
 
 // 3ds Max headers.
 #include <object.h>
 
+// Standard headers.
+#include <utility>
+
+namespace asf = foundation;
+
 
 //
 // MaxSceneEntities class implementation.
@@ -57,18 +68,65 @@ MaxSceneEntityCollector::MaxSceneEntityCollector(MaxSceneEntities& entities)
 {
 }
 
-void MaxSceneEntityCollector::collect(INode* node)
+void MaxSceneEntityCollector::collect(INode* scene, const TimeValue time)
 {
-    // Recurse into children.
-    for (int i = 0, e = node->NumberOfChildren(); i < e; ++i)
-        collect(node->GetChildNode(i));
+    asf::Stopwatch<asf::DefaultWallclockTimer> stopwatch;
+
+    // Gather renderable nodes.
+    stopwatch.start();
+    std::vector<INode*> nodes;
+    collect_renderable_nodes(scene, nodes);
+    const double traversal_time = stopwatch.measure().get_seconds();
+
+    // Sort them into objects and lights.
+    stopwatch.start();
+    m_entities.m_objects.reserve(m_entities.m_objects.size() + nodes.size());
+    for (INode* node : nodes)
+        classify_node(node, time);
+    const double classification_time = stopwatch.measure().get_seconds();
+
+    RENDERER_LOG_DEBUG(
+        "collected %s object(s) and %s light(s) from %s renderable node(s) "
+        "(traversal: %s, classification: %s).",
+        asf::pretty_uint(m_entities.m_objects.size()).c_str(),
+        asf::pretty_uint(m_entities.m_lights.size()).c_str(),
+        asf::pretty_uint(nodes.size()).c_str(),
+        asf::pretty_time(traversal_time).c_str(),
+        asf::pretty_time(classification_time).c_str());
+}
 
-    // Skip non-renderable nodes.
-    if (!node->Renderable())
-        return;
+void MaxSceneEntityCollector::collect_renderable_nodes(INode* scene, std::vector<INode*>& nodes)
+{
+    // Visit the hierarchy with an explicit stack to support arbitrarily deep hierarchies.
+    // Children are visited before their parent, like the recursive traversal used to do.
+    std::vector<std::pair<INode*, int>> stack;      // node, index of the next child to visit
+    stack.push_back(std::make_pair(scene, 0));
+
+    while (!stack.empty())
+    {
+        INode* node = stack.back().first;
+        const int child_index = stack.back().second;
 
+        if (child_index < node->NumberOfChildren())
+        {
+            ++stack.back().second;
+            stack.push_back(std::make_pair(node->GetChildNode(child_index), 0));
+        }
+        else
+        {
+            stack.pop_back();
+
+            // Skip non-renderable nodes.
+            if (node->Renderable())
+                nodes.push_back(node);
+        }
+    }
+}
+
+void MaxSceneEntityCollector::classify_node(INode* node, const TimeValue time)
+{
     // Retrieve the ObjectState structure of this node.
-    ObjectState object_state = node->EvalWorldState(0);
+    ObjectState object_state = node->EvalWorldState(time);
     if (object_state.obj == nullptr)
         return;
 
@@ -28,6 +28,12 @@
 
 #pragma once
 
+// appleseed.foundation headers.
+#include "foundation/platform/windows.h"    // include before 3ds Max headers
+
+// 3ds Max headers.
+#include <maxtypes.h>
+
 // Standard headers.
 #include <vector>
 
@@ -54,8 +60,12 @@ class MaxSceneEntityCollector
   public:
     explicit MaxSceneEntityCollector(MaxSceneEntities& entities);
 
-    void collect(INode* scene);
+    // Collect the renderable objects and lights of a scene, evaluated at a given time.
+    void collect(INode* scene, const TimeValue time);
 
   private:
     MaxSceneEntities& m_entities;
+
+    void collect_renderable_nodes(INode* scene, std::vector<INode*>& nodes);
+    void classify_node(INode* node, const TimeValue time);
 };
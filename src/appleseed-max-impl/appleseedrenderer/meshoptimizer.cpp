@@ -0,0 +1,335 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2018 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "meshoptimizer.h"
+
+// appleseed-max headers.
+#include "utilities.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/vector.h"
+#include "foundation/platform/types.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <unordered_map>
+
+namespace asf = foundation;
+namespace asr = renderer;
+
+namespace
+{
+    const asf::uint32 Unassigned = ~asf::uint32(0);
+
+    //
+    // Hashing and comparison of raw arrays.
+    //
+
+    template <typename T>
+    asf::uint64 hash_vector(const std::vector<T>& values, const asf::uint64 h)
+    {
+        const size_t size = values.size();
+        return
+            hash_bytes(
+                values.empty() ? nullptr : &values[0],
+                size * sizeof(T),
+                hash_bytes(&size, sizeof(size), h));
+    }
+
+    // Return true if two values have the same bytes.
+    template <typename T>
+    bool bitwise_equal(const T& lhs, const T& rhs)
+    {
+        return std::memcmp(&lhs, &rhs, sizeof(T)) == 0;
+    }
+
+    //
+    // Degenerate triangles removal.
+    //
+
+    bool is_degenerate(const MeshData& mesh, const asr::Triangle& triangle)
+    {
+        if (triangle.m_v0 == triangle.m_v1 ||
+            triangle.m_v1 == triangle.m_v2 ||
+            triangle.m_v2 == triangle.m_v0)
+            return true;
+
+        const asr::GVector3& v0 = mesh.m_vertices[triangle.m_v0];
+        const asr::GVector3& v1 = mesh.m_vertices[triangle.m_v1];
+        const asr::GVector3& v2 = mesh.m_vertices[triangle.m_v2];
+
+        return asf::square_norm(asf::cross(v1 - v0, v2 - v0)) == asr::GScalar(0.0);
+    }
+
+    void remove_degenerate_triangles(MeshData& mesh)
+    {
+        mesh.m_triangles.erase(
+            std::remove_if(
+                mesh.m_triangles.begin(),
+                mesh.m_triangles.end(),
+                [&mesh](const asr::Triangle& triangle)
+                {
+                    return is_degenerate(mesh, triangle);
+                }),
+            mesh.m_triangles.end());
+    }
+
+    //
+    // Welding of bitwise identical vectors.
+    //
+
+    template <typename Vector>
+    struct BitwiseHash
+    {
+        size_t operator()(const Vector& v) const
+        {
+            return static_cast<size_t>(hash_bytes(&v, sizeof(Vector)));
+        }
+    };
+
+    template <typename Vector>
+    struct BitwiseEqual
+    {
+        bool operator()(const Vector& lhs, const Vector& rhs) const
+        {
+            return std::memcmp(&lhs, &rhs, sizeof(Vector)) == 0;
+        }
+    };
+
+    // Remove duplicates from `values` and return the map from old to new indices.
+    template <typename Vector>
+    std::vector<asf::uint32> weld(std::vector<Vector>& values)
+    {
+        std::unordered_map<Vector, asf::uint32, BitwiseHash<Vector>, BitwiseEqual<Vector>> indices;
+        indices.reserve(values.size());
+
+        std::vector<asf::uint32> remap(values.size());
+        size_t unique_count = 0;
+
+        for (size_t i = 0, e = values.size(); i < e; ++i)
+        {
+            const auto result =
+                indices.insert(std::make_pair(values[i], static_cast<asf::uint32>(unique_count)));
+            if (result.second)
+                values[unique_count++] = values[i];
+            remap[i] = result.first->second;
+        }
+
+        values.resize(unique_count);
+
+        return remap;
+    }
+
+    asf::uint32 remap_index(const asf::uint32 index, const std::vector<asf::uint32>& remap)
+    {
+        return index == asr::Triangle::None ? index : remap[index];
+    }
+
+    void weld_normals_and_tex_coords(MeshData& mesh)
+    {
+        const std::vector<asf::uint32> normal_remap = weld(mesh.m_vertex_normals);
+        const std::vector<asf::uint32> tex_coord_remap = weld(mesh.m_tex_coords);
+
+        for (auto& triangle : mesh.m_triangles)
+        {
+            triangle.m_n0 = remap_index(triangle.m_n0, normal_remap);
+            triangle.m_n1 = remap_index(triangle.m_n1, normal_remap);
+            triangle.m_n2 = remap_index(triangle.m_n2, normal_remap);
+            triangle.m_a0 = remap_index(triangle.m_a0, tex_coord_remap);
+            triangle.m_a1 = remap_index(triangle.m_a1, tex_coord_remap);
+            triangle.m_a2 = remap_index(triangle.m_a2, tex_coord_remap);
+        }
+    }
+
+    //
+    // Renumbering of vertex attributes.
+    //
+
+    // Renumber `values` in order of first use by `triangles` through the given index members,
+    // dropping unreferenced values.
+    template <typename Vector>
+    void renumber_by_first_use(
+        std::vector<Vector>&            values,
+        std::vector<asr::Triangle>&     triangles,
+        asf::uint32 asr::Triangle::*    m0,
+        asf::uint32 asr::Triangle::*    m1,
+        asf::uint32 asr::Triangle::*    m2)
+    {
+        std::vector<asf::uint32> remap(values.size(), Unassigned);
+
+        std::vector<Vector> renumbered;
+        renumbered.reserve(values.size());
+
+        for (auto& triangle : triangles)
+        {
+            for (const auto member : { m0, m1, m2 })
+            {
+                asf::uint32& index = triangle.*member;
+                if (index == asr::Triangle::None)
+                    continue;
+
+                if (remap[index] == Unassigned)
+                {
+                    remap[index] = static_cast<asf::uint32>(renumbered.size());
+                    renumbered.push_back(values[index]);
+                }
+
+                index = remap[index];
+            }
+        }
+
+        values.swap(renumbered);
+    }
+}
+
+asf::uint64 MeshData::compute_hash() const
+{
+    asf::uint64 h = hash_bytes(nullptr, 0);
+    h = hash_vector(m_vertices, h);
+    h = hash_vector(m_vertex_normals, h);
+    h = hash_vector(m_tex_coords, h);
+    h = hash_vector(m_triangles, h);
+
+    for (const auto& slot : m_material_slots)
+        h = hash_bytes(slot.c_str(), slot.size() + 1, h);
+
+    return h;
+}
+
+void MeshData::push_to(asr::MeshObject& object) const
+{
+    object.reserve_vertices(m_vertices.size());
+    for (const auto& v : m_vertices)
+        object.push_vertex(v);
+
+    object.reserve_vertex_normals(m_vertex_normals.size());
+    for (const auto& n : m_vertex_normals)
+        object.push_vertex_normal(n);
+
+    object.reserve_tex_coords(m_tex_coords.size());
+    for (const auto& uv : m_tex_coords)
+        object.push_tex_coords(uv);
+
+    object.reserve_triangles(m_triangles.size());
+    for (const auto& triangle : m_triangles)
+        object.push_triangle(triangle);
+
+    for (const auto& slot : m_material_slots)
+        object.push_material_slot(slot.c_str());
+}
+
+void optimize_mesh(MeshData& mesh)
+{
+    remove_degenerate_triangles(mesh);
+    weld_normals_and_tex_coords(mesh);
+
+    renumber_by_first_use(mesh.m_vertices, mesh.m_triangles, &asr::Triangle::m_v0, &asr::Triangle::m_v1, &asr::Triangle::m_v2);
+    renumber_by_first_use(mesh.m_vertex_normals, mesh.m_triangles, &asr::Triangle::m_n0, &asr::Triangle::m_n1, &asr::Triangle::m_n2);
+    renumber_by_first_use(mesh.m_tex_coords, mesh.m_triangles, &asr::Triangle::m_a0, &asr::Triangle::m_a1, &asr::Triangle::m_a2);
+}
+
+size_t get_mesh_memory_size(const asr::MeshObject& object)
+{
+    size_t size = sizeof(object);
+    size += object.get_vertex_count() * sizeof(asr::GVector3);
+    size += object.get_vertex_normal_count() * sizeof(asr::GVector3);
+    size += object.get_tex_coords_count() * sizeof(asr::GVector2);
+    size += object.get_triangle_count() * sizeof(asr::Triangle);
+
+    for (size_t i = 0, e = object.get_material_slot_count(); i < e; ++i)
+        size += std::strlen(object.get_material_slot(i)) + 1;
+
+    return size;
+}
+
+bool have_identical_meshes(const asr::MeshObject& lhs, const asr::MeshObject& rhs)
+{
+    if (lhs.get_vertex_count() != rhs.get_vertex_count() ||
+        lhs.get_vertex_normal_count() != rhs.get_vertex_normal_count() ||
+        lhs.get_tex_coords_count() != rhs.get_tex_coords_count() ||
+        lhs.get_triangle_count() != rhs.get_triangle_count() ||
+        lhs.get_material_slot_count() != rhs.get_material_slot_count())
+        return false;
+
+    for (size_t i = 0, e = lhs.get_vertex_count(); i < e; ++i)
+    {
+        if (!bitwise_equal(lhs.get_vertex(i), rhs.get_vertex(i)))
+            return false;
+    }
+
+    for (size_t i = 0, e = lhs.get_vertex_normal_count(); i < e; ++i)
+    {
+        if (!bitwise_equal(lhs.get_vertex_normal(i), rhs.get_vertex_normal(i)))
+            return false;
+    }
+
+    for (size_t i = 0, e = lhs.get_tex_coords_count(); i < e; ++i)
+    {
+        if (!bitwise_equal(lhs.get_tex_coords(i), rhs.get_tex_coords(i)))
+            return false;
+    }
+
+    for (size_t i = 0, e = lhs.get_triangle_count(); i < e; ++i)
+    {
+        if (!bitwise_equal(lhs.get_triangle(i), rhs.get_triangle(i)))
+            return false;
+    }
+
+    for (size_t i = 0, e = lhs.get_material_slot_count(); i < e; ++i)
+    {
+        if (std::strcmp(lhs.get_material_slot(i), rhs.get_material_slot(i)) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+void copy_mesh(const asr::MeshObject& source, asr::MeshObject& destination)
+{
+    destination.reserve_vertices(source.get_vertex_count());
+    for (size_t i = 0, e = source.get_vertex_count(); i < e; ++i)
+        destination.push_vertex(source.get_vertex(i));
+
+    destination.reserve_vertex_normals(source.get_vertex_normal_count());
+    for (size_t i = 0, e = source.get_vertex_normal_count(); i < e; ++i)
+        destination.push_vertex_normal(source.get_vertex_normal(i));
+
+    destination.reserve_tex_coords(source.get_tex_coords_count());
+    for (size_t i = 0, e = source.get_tex_coords_count(); i < e; ++i)
+        destination.push_tex_coords(source.get_tex_coords(i));
+
+    destination.reserve_triangles(source.get_triangle_count());
+    for (size_t i = 0, e = source.get_triangle_count(); i < e; ++i)
+        destination.push_triangle(source.get_triangle(i));
+
+    for (size_t i = 0, e = source.get_material_slot_count(); i < e; ++i)
+        destination.push_material_slot(source.get_material_slot(i));
+}
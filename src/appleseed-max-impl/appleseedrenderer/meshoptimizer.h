@@ -0,0 +1,76 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2018 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.renderer headers.
+#include "renderer/api/object.h"
+
+// appleseed.foundation headers.
+#include "foundation/platform/types.h"
+
+// Standard headers.
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//
+// Mesh data produced by the conversion of a 3ds Max mesh, before it is handed to an appleseed mesh object.
+//
+
+struct MeshData
+{
+    std::vector<renderer::GVector3>     m_vertices;
+    std::vector<renderer::GVector3>     m_vertex_normals;
+    std::vector<renderer::GVector2>     m_tex_coords;
+    std::vector<renderer::Triangle>     m_triangles;
+    std::vector<std::string>            m_material_slots;
+
+    // Return a hash of the geometry, i.e. of all arrays above.
+    foundation::uint64 compute_hash() const;
+
+    // Copy the mesh data to an appleseed mesh object.
+    void push_to(renderer::MeshObject& object) const;
+};
+
+// Return the amount of memory used by the geometry of an appleseed mesh object, in bytes.
+size_t get_mesh_memory_size(const renderer::MeshObject& object);
+
+// Return true if the geometry of two appleseed mesh objects is bitwise identical.
+bool have_identical_meshes(const renderer::MeshObject& lhs, const renderer::MeshObject& rhs);
+
+// Copy the geometry of an appleseed mesh object to another, empty one.
+void copy_mesh(const renderer::MeshObject& source, renderer::MeshObject& destination);
+
+// Optimize mesh data in place:
+//   - remove degenerate triangles,
+//   - weld identical vertex normals and texture coordinates,
+//   - renumber vertices, normals and texture coordinates in order of first use,
+//     which drops unreferenced ones.
+// Material slots and the order of non-degenerate triangles are preserved.
+void optimize_mesh(MeshData& mesh);
@@ -33,9 +33,14 @@
 #include "appleseedenvmap/appleseedenvmap.h"
 #include "appleseedobjpropsmod/appleseedobjpropsmod.h"
 #include "appleseedrenderelement/appleseedrenderelement.h"
+#include "appleseedrenderer/environmentmapcache.h"
+#include "appleseedrenderer/geometrycache.h"
 #include "appleseedrenderer/maxsceneentities.h"
+#include "appleseedrenderer/meshoptimizer.h"
 #include "appleseedrenderer/renderersettings.h"
+#include "appleseedrenderer/vertextransform.h"
 #include "iappleseedmtl.h"
+#include "oslutils.h"
 #include "seexprutils.h"
 #include "utilities.h"
 
@@ -48,6 +53,7 @@
 #include "renderer/api/environmentshader.h"
 #include "renderer/api/frame.h"
 #include "renderer/api/light.h"
+#include "renderer/api/log.h"
 #include "renderer/api/material.h"
 #include "renderer/api/object.h"
 #include "renderer/api/project.h"
@@ -67,6 +73,7 @@
 #include "foundation/utility/containers/dictionary.h"
 #include "foundation/utility/iostreamop.h"
 #include "foundation/utility/searchpaths.h"
+#include "foundation/utility/string.h"
 
 // 3ds Max headers.
 #include <assert1.h>
@@ -74,6 +81,7 @@
 #include <genlight.h>
 #include <iInstanceMgr.h>
 #include <INodeTab.h>
+#include <iparamb2.h>
 #include <modstack.h>
 #include <object.h>
 #include <pbbitmap.h>
@@ -86,11 +94,16 @@
 #include <triobj.h>
 
 // Standard headers.
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <limits>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -175,43 +188,107 @@ namespace
     {
         std::string                     m_name;             // name of the appleseed object
         std::map<MtlID, asf::uint32>    m_mtlid_to_slot;    // map a 3ds Max's material ID to an appleseed's material slot
+        asf::uint64                     m_content_hash;     // hash of the geometry of the appleseed object
+        const asr::MeshObject*          m_object;           // the appleseed object
     };
 
-    asf::auto_release_ptr<asr::MeshObject> convert_mesh_object(
+    // A 3ds Max render mesh retrieved on the main thread and waiting to be converted.
+    struct PendingMesh
+    {
+        Mesh*                   m_mesh;
+        BOOL                    m_need_delete;      // whether the mesh must be deleted once converted
+        Matrix3                 m_transform;
+        Interval                m_validity;         // validity of the mesh and of its transform
+        GeometryCache::Key      m_cache_key;
+        asr::Assembly*          m_assembly;
+        asr::MeshObject*        m_object;           // appleseed object to fill, owned by m_assembly
+        asr::MeshObject*        m_cached_object;    // object handed over by the geometry cache to replace m_object, if any
+        ObjectInfo*             m_object_info;
+    };
+
+    // Compute a hash of the raw data of a 3ds Max mesh and of its transform.
+    asf::uint64 compute_mesh_signature(
         Mesh&                   mesh,
-        const Matrix3&          mesh_transform,
-        ObjectInfo&             object_info)
+        const Matrix3&          mesh_transform)
     {
-        asf::auto_release_ptr<asr::MeshObject> object(
-            asr::MeshObjectFactory().create(object_info.m_name.c_str(), asr::ParamArray()));
+        asf::uint64 h = hash_bytes(nullptr, 0);
 
-        // Make sure the input mesh has vertex normals.
-        mesh.checkNormals(TRUE);
+        for (int i = 0; i < 4; ++i)
+        {
+            const Point3 row = mesh_transform.GetRow(i);
+            h = hash_bytes(&row, sizeof(row), h);
+        }
 
-        // Copy vertices to the mesh object.
-        object->reserve_vertices(mesh.getNumVerts());
-        for (int i = 0, e = mesh.getNumVerts(); i < e; ++i)
+        const int counts[3] = { mesh.getNumVerts(), mesh.getNumFaces(), mesh.getNumTVerts() };
+        h = hash_bytes(counts, sizeof(counts), h);
+        h = hash_bytes(mesh.verts, mesh.getNumVerts() * sizeof(Point3), h);
+        h = hash_bytes(mesh.faces, mesh.getNumFaces() * sizeof(Face), h);
+
+        if (mesh.getNumTVerts() > 0)
         {
-            const Point3 v = mesh_transform * mesh.getVert(i);
-            object->push_vertex(asr::GVector3(v.x, v.y, v.z));
+            h = hash_bytes(mesh.tVerts, mesh.getNumTVerts() * sizeof(UVVert), h);
+            h = hash_bytes(mesh.tvFace, mesh.getNumFaces() * sizeof(TVFace), h);
         }
 
-        // Copy texture vertices to the mesh object.
-        object->reserve_tex_coords(mesh.getNumTVerts());
+        return h;
+    }
+
+    // Convert a 3ds Max mesh to appleseed geometry.
+    // Does not call into 3ds Max beyond reading the mesh, hence may be called from any thread.
+    // The geometry is optimized (see meshoptimizer.h).
+    void convert_mesh_object(
+        Mesh&                   mesh,
+        const Matrix3&          mesh_transform,
+        const std::string&              name,
+        MeshData&                       mesh_data,
+        std::map<MtlID, asf::uint32>&   mtlid_to_slot)
+    {
+        // Copy and transform vertices.
+        mesh_data.m_vertices.resize(mesh.getNumVerts());
+        transform_points(
+            mesh_transform,
+            mesh.verts,
+            mesh_data.m_vertices.size(),
+            mesh_data.m_vertices.data());
+
+        // Copy texture vertices.
+        mesh_data.m_tex_coords.reserve(mesh.getNumTVerts());
         for (int i = 0, e = mesh.getNumTVerts(); i < e; ++i)
         {
             const UVVert& uv = mesh.getTVert(i);
-            object->push_tex_coords(asr::GVector2(uv.x, uv.y));
+            mesh_data.m_tex_coords.push_back(asr::GVector2(uv.x, uv.y));
         }
 
-        // Compute the matrix to transform normals.
-        Matrix3 normal_transform = mesh_transform;
-        normal_transform.Invert();
-        normal_transform = transpose(normal_transform);
+        // Vertices shared by faces of the same smoothing group share their normals, so each
+        // distinct normal is only emitted once. Normals are emitted in object space and are
+        // transformed all at once after the triangles have been built. Normal `k` of vertex `v` is identified by the
+        // slot `normal_base[v] + k` which holds its index in the mesh object once emitted.
+        const asf::uint32 NoNormal = ~asf::uint32(0);
+        std::vector<asf::uint32> normal_base(mesh.getNumVerts() + 1, 0);
+        for (int i = 0, e = mesh.getNumVerts(); i < e; ++i)
+        {
+            const asf::uint32 normal_count = mesh.getRVert(i).rFlags & NORCT_MASK;
+            normal_base[i + 1] = normal_base[i] + std::max<asf::uint32>(normal_count, 1);
+        }
+        std::vector<asf::uint32> normal_slots(normal_base.back(), NoNormal);
 
-        // Copy vertex normals and triangles to mesh object.
-        object->reserve_vertex_normals(mesh.getNumFaces() * 3);
-        object->reserve_triangles(mesh.getNumFaces());
+        const auto push_vertex_normal = [&mesh_data, &normal_base, &normal_slots, NoNormal](
+            const DWORD             vertex_index,
+            const size_t            normal_index,
+            const Point3&           n) -> asf::uint32
+        {
+            asf::uint32& slot = normal_slots[normal_base[vertex_index] + normal_index];
+            if (slot == NoNormal)
+            {
+                slot = static_cast<asf::uint32>(mesh_data.m_vertex_normals.size());
+                mesh_data.m_vertex_normals.push_back(asr::GVector3(n.x, n.y, n.z));
+            }
+            return slot;
+        };
+
+        // Copy vertex normals and triangles.
+        mesh_data.m_vertex_normals.reserve(normal_slots.size());
+        mesh_data.m_triangles.reserve(mesh.getNumFaces());
         for (int i = 0, e = mesh.getNumFaces(); i < e; ++i)
         {
             Face& face = mesh.faces[i];
@@ -220,51 +297,57 @@ namespace
             const DWORD face_smgroup = face.getSmGroup();
             const MtlID face_mat = face.getMatID();
 
+            // The face normal is only emitted if one of the corners needs it.
+            asf::uint32 face_normal_index = NoNormal;
+            const auto get_face_normal_index = [&mesh_data, &mesh, &face_normal_index, NoNormal, i]()
+            {
+                if (face_normal_index == NoNormal)
+                {
+                    const Point3& n = mesh.getFaceNormal(i);
+                    face_normal_index = static_cast<asf::uint32>(mesh_data.m_vertex_normals.size());
+                    mesh_data.m_vertex_normals.push_back(asr::GVector3(n.x, n.y, n.z));
+                }
+                return face_normal_index;
+            };
+
             asf::uint32 normal_indices[3];
             if (face_smgroup == 0)
             {
                 // No smooth group for this face, use the face normal.
-                const Point3 n = normal_transform * mesh.getFaceNormal(i);
-                const asf::uint32 normal_index =
-                    static_cast<asf::uint32>(
-                        object->push_vertex_normal(
-                            asf::safe_normalize(asr::GVector3(n.x, n.y, n.z))));
-                normal_indices[0] = normal_index;
-                normal_indices[1] = normal_index;
-                normal_indices[2] = normal_index;
+                normal_indices[0] = get_face_normal_index();
+                normal_indices[1] = normal_indices[0];
+                normal_indices[2] = normal_indices[0];
             }
             else
             {
                 for (int j = 0; j < 3; ++j)
                 {
-                    RVertex& rvertex = mesh.getRVert(face.getVert(j));
+                    const DWORD vertex_index = face.getVert(j);
+                    RVertex& rvertex = mesh.getRVert(vertex_index);
                     const size_t normal_count = rvertex.rFlags & NORCT_MASK;
                     if (normal_count == 1)
                     {
                         // This vertex has a single normal.
-                        const Point3& n = rvertex.rn.getNormal();
-                        normal_indices[j] =
-                            static_cast<asf::uint32>(
-                                object->push_vertex_normal(
-                                    asf::safe_normalize(asr::GVector3(n.x, n.y, n.z))));
+                        normal_indices[j] = push_vertex_normal(vertex_index, 0, rvertex.rn.getNormal());
                     }
                     else
                     {
                         // This vertex has multiple normals.
+                        normal_indices[j] = NoNormal;
                         for (size_t k = 0; k < normal_count; ++k)
                         {
                             // Find the normal for this smooth group and material.
                             RNormal& rn = rvertex.ern[k];
                             if ((face_smgroup & rn.getSmGroup()) && face_mat == rn.getMtlIndex())
                             {
-                                const Point3& n = rn.getNormal();
-                                normal_indices[j] =
-                                    static_cast<asf::uint32>(
-                                        object->push_vertex_normal(
-                                            asf::safe_normalize(asr::GVector3(n.x, n.y, n.z))));
+                                normal_indices[j] = push_vertex_normal(vertex_index, k, rn.getNormal());
                                 break;
                             }
                         }
+
+                        // No normal matches this face, fall back to the face normal.
+                        if (normal_indices[j] == NoNormal)
+                            normal_indices[j] = get_face_normal_index();
                     }
                 }
             }
@@ -297,92 +380,268 @@ namespace
             // creating a new material slot if necessary.
             asf::uint32 slot;
             const MtlID mtlid = face.getMatID();
-            const auto it = object_info.m_mtlid_to_slot.find(mtlid);
-            if (it == object_info.m_mtlid_to_slot.end())
+            const auto it = mtlid_to_slot.find(mtlid);
+            if (it == mtlid_to_slot.end())
             {
                 // Create a new material slot in the object.
-                const auto slot_name = "material_slot_" + asf::to_string(object->get_material_slot_count());
-                slot = static_cast<asf::uint32>(object->push_material_slot(slot_name.c_str()));
-                object_info.m_mtlid_to_slot.insert(std::make_pair(mtlid, slot));
+                slot = static_cast<asf::uint32>(mesh_data.m_material_slots.size());
+                mesh_data.m_material_slots.push_back("material_slot_" + asf::to_string(slot));
+                mtlid_to_slot.insert(std::make_pair(mtlid, slot));
             }
             else slot = it->second;
             triangle.m_pa = slot;
 
-            object->push_triangle(triangle);
+            mesh_data.m_triangles.push_back(triangle);
         }
 
-        // todo: optimize the object.
-
-        return object;
+        // Transform normals by the inverse transpose of the mesh transform.
+        Matrix3 normal_transform = mesh_transform;
+        normal_transform.Invert();
+        normal_transform = transpose(normal_transform);
+        transform_vectors(
+            normal_transform,
+            mesh_data.m_vertex_normals.data(),
+            mesh_data.m_vertex_normals.size(),
+            mesh_data.m_vertex_normals.data());
+        for (asr::GVector3& n : mesh_data.m_vertex_normals)
+            n = asf::safe_normalize(n);
+
+        const size_t input_triangle_count = mesh_data.m_triangles.size();
+        const size_t input_vertex_count = mesh_data.m_vertices.size();
+
+        optimize_mesh(mesh_data);
+
+        RENDERER_LOG_DEBUG(
+            "optimized mesh object \"%s\": %s triangles, %s vertices (before: %s triangles, %s vertices).",
+            name.c_str(),
+            asf::pretty_uint(mesh_data.m_triangles.size()).c_str(),
+            asf::pretty_uint(mesh_data.m_vertices.size()).c_str(),
+            asf::pretty_uint(input_triangle_count).c_str(),
+            asf::pretty_uint(input_vertex_count).c_str());
     }
 
-    std::vector<ObjectInfo> create_mesh_objects(
-        asr::Assembly&          assembly,
-        INode*                  object_node,
-        const TimeValue         time)
+    void create_mesh_objects(
+        asr::Assembly&              assembly,
+        INode*                      object_node,
+        const TimeValue             time,
+        std::vector<ObjectInfo>&    object_infos,
+        std::vector<PendingMesh>&   pending_meshes)
     {
-        std::vector<ObjectInfo> object_infos;
+        std::vector<PendingMesh> node_meshes;
 
         // Retrieve the GeomObject at the desired time.
         const ObjectState object_state = object_node->EvalWorldState(time);
         GeomObject* geom_object = static_cast<GeomObject*>(object_state.obj);
+        const Interval object_validity = geom_object->ObjectValidity(time);
 
-        // Create one appleseed MeshObject per 3ds Max Mesh.
+        // Retrieve the 3ds Max meshes.
         const int render_mesh_count = geom_object->NumberOfRenderMeshes();
         if (render_mesh_count > 0)
         {
             for (int i = 0; i < render_mesh_count; ++i)
             {
                 NullView view;
-                BOOL need_delete;
-                Mesh* mesh = geom_object->GetMultipleRenderMesh(time, object_node, view, need_delete, i);
-                if (mesh != nullptr)
+                PendingMesh pending_mesh;
+                pending_mesh.m_mesh = geom_object->GetMultipleRenderMesh(time, object_node, view, pending_mesh.m_need_delete, i);
+                if (pending_mesh.m_mesh != nullptr)
                 {
-                    ObjectInfo object_info;
-                    object_info.m_name = wide_to_utf8(object_node->GetName());
-                    object_info.m_name = make_unique_name(assembly.objects(), object_info.m_name);
-
-                    Matrix3 mesh_transform;
                     Interval mesh_transform_validity;
-                    geom_object->GetMultipleRenderMeshTM(time, object_node, view, i, mesh_transform, mesh_transform_validity);
-
-                    assembly.objects().insert(
-                        asf::auto_release_ptr<asr::Object>(
-                            convert_mesh_object(*mesh, mesh_transform, object_info)));
-            
-                    if (need_delete)
-                        mesh->DeleteThis();
-
-                    object_infos.push_back(object_info);
+                    geom_object->GetMultipleRenderMeshTM(time, object_node, view, i, pending_mesh.m_transform, mesh_transform_validity);
+                    pending_mesh.m_validity = object_validity & mesh_transform_validity;
+                    pending_mesh.m_cache_key = GeometryCache::Key(object_node->GetHandle(), i);
+                    node_meshes.push_back(pending_mesh);
                 }
             }
         }
         else
         {
             NullView view;
-            BOOL need_delete;
-            Mesh* mesh = geom_object->GetRenderMesh(time, object_node, view, need_delete);
-            if (mesh != nullptr)
+            PendingMesh pending_mesh;
+            pending_mesh.m_mesh = geom_object->GetRenderMesh(time, object_node, view, pending_mesh.m_need_delete);
+            if (pending_mesh.m_mesh != nullptr)
             {
-                ObjectInfo object_info;
-                object_info.m_name = wide_to_utf8(object_node->GetName());
-                object_info.m_name = make_unique_name(assembly.objects(), object_info.m_name);
+                pending_mesh.m_transform = Matrix3(TRUE);
+                pending_mesh.m_validity = object_validity;
+                pending_mesh.m_cache_key = GeometryCache::Key(object_node->GetHandle(), 0);
+                node_meshes.push_back(pending_mesh);
+            }
+        }
+
+        // Create one empty appleseed MeshObject per 3ds Max Mesh. Names are assigned here,
+        // in scene order, so that they don't depend on the order in which meshes get converted.
+        object_infos.resize(node_meshes.size());
+        for (size_t i = 0, e = node_meshes.size(); i < e; ++i)
+        {
+            PendingMesh& pending_mesh = node_meshes[i];
+            ObjectInfo& object_info = object_infos[i];
+
+            // Make sure the input mesh has vertex normals.
+            pending_mesh.m_mesh->checkNormals(TRUE);
+
+            object_info.m_name = wide_to_utf8(object_node->GetName());
+            object_info.m_name = make_unique_name(assembly.objects(), object_info.m_name);
 
-                assembly.objects().insert(
-                    asf::auto_release_ptr<asr::Object>(
-                        convert_mesh_object(*mesh, Matrix3(TRUE), object_info)));
+            asf::auto_release_ptr<asr::MeshObject> object(
+                asr::MeshObjectFactory().create(object_info.m_name.c_str(), asr::ParamArray()));
+            pending_mesh.m_assembly = &assembly;
+            pending_mesh.m_object = object.get();
+            pending_mesh.m_cached_object = nullptr;
+            pending_mesh.m_object_info = &object_info;
+            object_info.m_object = object.get();
 
-                if (need_delete)
-                    mesh->DeleteThis();
+            assembly.objects().insert(asf::auto_release_ptr<asr::Object>(object));
+
+            pending_meshes.push_back(pending_mesh);
+        }
+    }
+
+    void release_pending_meshes(std::vector<PendingMesh>& pending_meshes)
+    {
+        for (const auto& pending_mesh : pending_meshes)
+        {
+            if (pending_mesh.m_need_delete)
+                pending_mesh.m_mesh->DeleteThis();
+
+            if (pending_mesh.m_cached_object != nullptr)
+                pending_mesh.m_cached_object->release();
+        }
 
-                object_infos.push_back(object_info);
+        pending_meshes.clear();
+    }
+
+    void convert_pending_mesh(
+        PendingMesh&                pending_mesh,
+        const TimeValue             time,
+        GeometryCache*              geometry_cache)
+    {
+        ObjectInfo& object_info = *pending_mesh.m_object_info;
+        asf::uint64 signature = 0;
+
+        // Reuse the geometry converted during a previous render if the mesh didn't change.
+        if (geometry_cache != nullptr)
+        {
+            signature = compute_mesh_signature(*pending_mesh.m_mesh, pending_mesh.m_transform);
+
+            CachedGeometry geometry;
+            if (geometry_cache->lookup(
+                    pending_mesh.m_cache_key,
+                    time,
+                    signature,
+                    object_info.m_name.c_str(),
+                    *pending_mesh.m_object,
+                    geometry))
+            {
+                object_info.m_mtlid_to_slot = geometry.m_mtlid_to_slot;
+                object_info.m_content_hash = geometry.m_content_hash;
+                pending_mesh.m_cached_object = geometry.m_object.release();
+                return;
             }
         }
 
-        return object_infos;
+        // The converted arrays are only kept until they are copied to the appleseed object.
+        MeshData mesh_data;
+        convert_mesh_object(
+            *pending_mesh.m_mesh,
+            pending_mesh.m_transform,
+            object_info.m_name,
+            mesh_data,
+            object_info.m_mtlid_to_slot);
+        object_info.m_content_hash = mesh_data.compute_hash();
+        mesh_data.push_to(*pending_mesh.m_object);
+
+        if (geometry_cache != nullptr)
+        {
+            geometry_cache->insert(
+                pending_mesh.m_cache_key,
+                pending_mesh.m_validity,
+                signature,
+                *pending_mesh.m_object,
+                object_info.m_content_hash,
+                object_info.m_mtlid_to_slot);
+        }
     }
 
-    typedef std::map<Mtl*, std::string> MaterialMap;
+    // Replace empty appleseed objects by the objects handed over by the geometry cache.
+    // Must be called from the main thread.
+    void install_cached_objects(std::vector<PendingMesh>& pending_meshes)
+    {
+        for (auto& pending_mesh : pending_meshes)
+        {
+            if (pending_mesh.m_cached_object == nullptr)
+                continue;
+
+            asr::ObjectContainer& objects = pending_mesh.m_assembly->objects();
+            objects.remove(pending_mesh.m_object);
+
+            pending_mesh.m_object = pending_mesh.m_cached_object;
+            pending_mesh.m_cached_object = nullptr;
+            pending_mesh.m_object_info->m_object = pending_mesh.m_object;
+
+            objects.insert(asf::auto_release_ptr<asr::Object>(pending_mesh.m_object));
+        }
+    }
+
+    // Convert pending meshes in parallel and release them. Progress is reported in the second third
+    // of a range of `3 * progress_total` steps. Return false if rendering was aborted, in which case
+    // some meshes may not be converted.
+    bool convert_pending_meshes(
+        std::vector<PendingMesh>&   pending_meshes,
+        const TimeValue             time,
+        const size_t                thread_count,
+        GeometryCache*              geometry_cache,
+        RendProgressCallback*       progress_cb,
+        const int                   progress_total)
+    {
+        // Convert the largest meshes first so that threads finish at roughly the same time.
+        std::vector<size_t> order(pending_meshes.size());
+        for (size_t i = 0, e = order.size(); i < e; ++i)
+            order[i] = i;
+        std::stable_sort(
+            order.begin(),
+            order.end(),
+            [&pending_meshes](const size_t lhs, const size_t rhs)
+            {
+                return pending_meshes[lhs].m_mesh->getNumFaces() > pending_meshes[rhs].m_mesh->getNumFaces();
+            });
+
+        // Progress is only reported from the calling thread since 3ds Max's UI isn't thread-safe.
+        const std::thread::id calling_thread_id = std::this_thread::get_id();
+        std::atomic<size_t> completed_count(0);
+        std::atomic<bool> aborted(false);
+
+        try
+        {
+            parallel_for(
+                order.size(),
+                thread_count,
+                [&](const size_t i)
+                {
+                    if (aborted)
+                        return;
+
+                    convert_pending_mesh(pending_meshes[order[i]], time, geometry_cache);
+                    ++completed_count;
+
+                    if (std::this_thread::get_id() == calling_thread_id)
+                    {
+                        const int done =
+                            static_cast<int>(completed_count * progress_total / pending_meshes.size());
+                        if (progress_cb->Progress(progress_total + done, 3 * progress_total) == RENDPROG_ABORT)
+                            aborted = true;
+                    }
+                });
+        }
+        catch (...)
+        {
+            release_pending_meshes(pending_meshes);
+            throw;
+        }
+
+        install_cached_objects(pending_meshes);
+        release_pending_meshes(pending_meshes);
+
+        return !aborted;
+    }
 
     struct MaterialInfo
     {
@@ -404,7 +663,8 @@ namespace
         if (appleseed_mtl)
         {
             // It's an appleseed material.
-            const auto it = material_map.find(mtl);
+            const auto key = std::make_pair(&assembly, mtl);
+            const auto it = material_map.find(key);
             if (it == material_map.end())
             {
                 // The appleseed material does not exist yet, let the material plugin create it.
@@ -412,7 +672,7 @@ namespace
                     make_unique_name(assembly.materials(), wide_to_utf8(mtl->GetName()) + "_mat");
                 assembly.materials().insert(
                     appleseed_mtl->create_material(assembly, material_info.m_name.c_str(), use_max_procedural_maps));
-                material_map.insert(std::make_pair(mtl, material_info.m_name));
+                material_map.insert(std::make_pair(key, material_info.m_name));
             }
             else
             {
@@ -495,7 +755,8 @@ namespace
         MaterialPreview
     };
 
-    void create_object_instance(
+    // Create an instance of an object and return its name.
+    std::string create_object_instance(
         asr::Assembly&          assembly,
         INode*                  instance_node,
         const asf::Transformd&  transform,
@@ -622,48 +883,294 @@ namespace
                 transform,
                 front_material_mappings,
                 back_material_mappings));
+
+        return instance_name;
     }
 
     typedef std::map<Object*, std::vector<ObjectInfo>> ObjectMap;
     typedef std::map<Object*, std::string> AssemblyMap;
 
-    void add_object(
+    // Retrieve the meshes of the object referenced by a node and create the corresponding
+    // (empty) appleseed objects. Must be called from the main thread.
+    void prepare_object(
+        asr::Assembly&              assembly,
+        INode*                      node,
+        const TimeValue             time,
+        ObjectMap&                  object_map,
+        AssemblyMap&                assembly_map,
+        std::vector<PendingMesh>&   pending_meshes)
+    {
+        // Retrieve the geometrical object referenced by this node.
+        Object* object = node->GetObjectRef();
+
+        // Check if we already prepared the corresponding appleseed objects.
+        if (object_map.find(object) != object_map.end())
+            return;
+
+        std::vector<ObjectInfo>& object_infos = object_map[object];
+
+        if (should_optimize_for_instancing(object, time))
+        {
+            std::string assembly_name = wide_to_utf8(node->GetName());
+            assembly_name = make_unique_name(assembly.assemblies(), assembly_name + "_assembly");
+
+            // Create an assembly and add objects to it.
+            asf::auto_release_ptr<asr::Assembly> object_assembly(
+                asr::AssemblyFactory().create(assembly_name.c_str()));
+            create_mesh_objects(object_assembly.ref(), node, time, object_infos, pending_meshes);
+
+            assembly_map.insert(std::make_pair(object, assembly_name));
+
+            // Insert the assembly into the scene.
+            assembly.assemblies().insert(object_assembly);
+        }
+        else
+        {
+            create_mesh_objects(assembly, node, time, object_infos, pending_meshes);
+        }
+    }
+
+    // Identical geometry used by several nodes is moved to its own assembly if this saves
+    // at least that many triangles in the acceleration structure of the scene assembly.
+    const size_t AutoInstancingMinSavedTriangles = 100000;
+
+    asf::uint64 get_geometry_hash(const std::vector<ObjectInfo>& object_infos)
+    {
+        asf::uint64 h = hash_bytes(nullptr, 0);
+
+        for (const auto& object_info : object_infos)
+            h = hash_bytes(&object_info.m_content_hash, sizeof(asf::uint64), h);
+
+        return h;
+    }
+
+    bool have_identical_geometry(
+        const std::vector<ObjectInfo>&  lhs,
+        const std::vector<ObjectInfo>&  rhs)
+    {
+        if (lhs.size() != rhs.size())
+            return false;
+
+        for (size_t i = 0, e = lhs.size(); i < e; ++i)
+        {
+            const ObjectInfo& lhs_info = lhs[i];
+            const ObjectInfo& rhs_info = rhs[i];
+
+            if (lhs_info.m_object == rhs_info.m_object)
+                continue;
+
+            if (lhs_info.m_content_hash != rhs_info.m_content_hash ||
+                lhs_info.m_mtlid_to_slot != rhs_info.m_mtlid_to_slot ||
+                !have_identical_meshes(*lhs_info.m_object, *rhs_info.m_object))
+                return false;
+        }
+
+        return true;
+    }
+
+    // Return true if instances of the same objects created for two nodes would be identical.
+    bool have_identical_shading(
+        INode*                  lhs,
+        INode*                  rhs,
+        const TimeValue         time)
+    {
+        if (lhs->GetMtl() != rhs->GetMtl())
+            return false;
+
+        // Nodes without material get a default material based on their wire color.
+        if (lhs->GetMtl() == nullptr && lhs->GetWireColor() != rhs->GetWireColor())
+            return false;
+
+        return
+            get_visibility_flags(lhs->GetObjectRef(), time) == get_visibility_flags(rhs->GetObjectRef(), time) &&
+            get_sss_set(lhs->GetObjectRef(), time) == get_sss_set(rhs->GetObjectRef(), time);
+    }
+
+    // Share appleseed objects between 3ds Max objects that are not instances of each other
+    // but have identical geometry, e.g. copies of the same object. Objects whose instances
+    // would contribute many triangles to the scene assembly are moved to their own assembly.
+    void share_identical_objects(
+        asr::Assembly&          assembly,
+        const MaxSceneEntities& entities,
+        const TimeValue         time,
+        ObjectMap&              object_map,
+        AssemblyMap&            assembly_map)
+    {
+        struct Usage
+        {
+            INode*  m_first_node;
+            size_t  m_node_count;
+            bool    m_identical_shading;
+        };
+
+        std::unordered_multimap<asf::uint64, Object*> objects_by_hash;
+        std::map<Object*, Object*> canonical_objects;
+        std::vector<Object*> canonical_object_order;
+        size_t shared_object_count = 0;
+
+        // Find objects with identical geometry, in scene order.
+        for (const auto& node : entities.m_objects)
+        {
+            Object* object = node->GetObjectRef();
+
+            // Skip objects already processed and objects explicitly optimized for instancing.
+            if (canonical_objects.find(object) != canonical_objects.end() ||
+                assembly_map.find(object) != assembly_map.end())
+                continue;
+
+            std::vector<ObjectInfo>& object_infos = object_map.find(object)->second;
+            if (object_infos.empty())
+                continue;
+
+            const asf::uint64 geometry_hash = get_geometry_hash(object_infos);
+
+            Object* canonical_object = nullptr;
+            const auto range = objects_by_hash.equal_range(geometry_hash);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (have_identical_geometry(object_map.find(it->second)->second, object_infos))
+                {
+                    canonical_object = it->second;
+                    break;
+                }
+            }
+
+            if (canonical_object == nullptr)
+            {
+                objects_by_hash.insert(std::make_pair(geometry_hash, object));
+                canonical_objects.insert(std::make_pair(object, object));
+                canonical_object_order.push_back(object);
+                continue;
+            }
+
+            // Use the appleseed objects of the identical object instead of this object's.
+            const std::vector<ObjectInfo>& canonical_object_infos = object_map.find(canonical_object)->second;
+            for (size_t i = 0, e = object_infos.size(); i < e; ++i)
+            {
+                assembly.objects().remove(assembly.objects().get_by_name(object_infos[i].m_name.c_str()));
+                object_infos[i] = canonical_object_infos[i];
+            }
+
+            canonical_objects.insert(std::make_pair(object, canonical_object));
+            ++shared_object_count;
+        }
+
+        // Count the nodes using each set of identical objects.
+        std::map<Object*, Usage> usages;
+        for (const auto& node : entities.m_objects)
+        {
+            const auto it = canonical_objects.find(node->GetObjectRef());
+            if (it == canonical_objects.end())
+                continue;
+
+            const auto usage_it = usages.find(it->second);
+            if (usage_it == usages.end())
+            {
+                Usage usage;
+                usage.m_first_node = node;
+                usage.m_node_count = 1;
+                usage.m_identical_shading = true;
+                usages.insert(std::make_pair(it->second, usage));
+            }
+            else
+            {
+                Usage& usage = usage_it->second;
+                ++usage.m_node_count;
+                if (usage.m_identical_shading && !have_identical_shading(usage.m_first_node, node, time))
+                    usage.m_identical_shading = false;
+            }
+        }
+
+        // Move large repeated sets of objects to their own assembly. The object instances of
+        // such an assembly are shared by all its instances, hence this requires all nodes to
+        // use the same material and object properties.
+        size_t assembly_count = 0;
+        for (Object* canonical_object : canonical_object_order)
+        {
+            const Usage& usage = usages.find(canonical_object)->second;
+            if (usage.m_node_count < 2 || !usage.m_identical_shading)
+                continue;
+
+            const std::vector<ObjectInfo>& object_infos = object_map.find(canonical_object)->second;
+
+            size_t triangle_count = 0;
+            for (const auto& object_info : object_infos)
+                triangle_count += object_info.m_object->get_triangle_count();
+
+            if (triangle_count * (usage.m_node_count - 1) < AutoInstancingMinSavedTriangles)
+                continue;
+
+            std::string assembly_name = wide_to_utf8(usage.m_first_node->GetName());
+            assembly_name = make_unique_name(assembly.assemblies(), assembly_name + "_assembly");
+
+            asf::auto_release_ptr<asr::Assembly> object_assembly(
+                asr::AssemblyFactory().create(assembly_name.c_str()));
+
+            for (const auto& object_info : object_infos)
+            {
+                object_assembly->objects().insert(
+                    assembly.objects().remove(
+                        assembly.objects().get_by_name(object_info.m_name.c_str())));
+            }
+
+            assembly.assemblies().insert(object_assembly);
+
+            for (const auto& entry : canonical_objects)
+            {
+                if (entry.second == canonical_object)
+                    assembly_map.insert(std::make_pair(entry.first, assembly_name));
+            }
+
+            ++assembly_count;
+        }
+
+        RENDERER_LOG_DEBUG(
+            "automatic instancing: %s object(s) shared, %s assembl%s created.",
+            asf::pretty_uint(shared_object_count).c_str(),
+            asf::pretty_uint(assembly_count).c_str(),
+            assembly_count == 1 ? "y" : "ies");
+    }
+
+    // Instantiate the appleseed objects prepared for the object referenced by a node.
+    void instantiate_object(
         asr::Assembly&          assembly,
         INode*                  node,
         const RenderType        type,
         const bool              use_max_proc_maps,
         const TimeValue         time,
-        ObjectMap&              object_map,
+        const ObjectMap&        object_map,
         MaterialMap&            material_map,
-        AssemblyMap&            assembly_map)
+        const AssemblyMap&      assembly_map,
+        InstanceMap&            instance_map)
     {
         // Retrieve the geometrical object referenced by this node.
         Object* object = node->GetObjectRef();
 
+        const ObjectMap::const_iterator object_it = object_map.find(object);
+        DbgAssert(object_it != object_map.end());
+        const auto& object_infos = object_it->second;
+
         // Compute the transform of this instance.
-        const asf::Transformd transform =
-            asf::Transformd::from_local_to_parent(
-                to_matrix4d(node->GetObjTMAfterWSM(time)));
+        const asf::Transformd transform = get_node_transform(node, time);
 
-        if (should_optimize_for_instancing(object, time))
-        {
-            std::string assembly_name = wide_to_utf8(node->GetName());
-            assembly_name = make_unique_name(assembly.assemblies(), assembly_name + "_assembly");
+        // Record the instances created for this node.
+        NodeInstances& node_instances = instance_map[node];
+        node_instances.m_assembly = &assembly;
 
-            const AssemblyMap::const_iterator it = assembly_map.find(object);
+        const AssemblyMap::const_iterator assembly_it = assembly_map.find(object);
+        if (assembly_it != assembly_map.end())
+        {
+            const std::string& assembly_name = assembly_it->second;
+            asr::Assembly* object_assembly = assembly.assemblies().get_by_name(assembly_name.c_str());
+            DbgAssert(object_assembly != nullptr);
 
-            if (it == assembly_map.end())
+            // Add object instances to the assembly when it is instantiated for the first time.
+            if (object_assembly->object_instances().empty())
             {
-                // Create an assembly.
-                asf::auto_release_ptr<asr::Assembly> object_assembly(
-                    asr::AssemblyFactory().create(assembly_name.c_str()));
-
-                // Add objects and object instances to it.
-                const auto object_infos = create_mesh_objects(object_assembly.ref(), node, time);
                 for (const auto& object_info : object_infos)
                 {
                     create_object_instance(
-                        object_assembly.ref(),
+                        *object_assembly,
                         node,
                         asf::Transformd::identity(),
                         object_info,
@@ -672,15 +1179,6 @@ namespace
                         time,
                         material_map);
                 }
-
-                assembly_map.insert(std::make_pair(object, assembly_name));
-                    
-                // Insert the assembly into the scene.
-                assembly.assemblies().insert(object_assembly);
-            }
-            else
-            {
-                assembly_name = it->second;
             }
 
             // Create an instance of the assembly and insert it into the scene.
@@ -696,35 +1194,13 @@ namespace
                 .set_transform(0.0, transform);
 
             assembly.assembly_instances().insert(object_assembly_instance);
+            node_instances.m_assembly_instance_names.push_back(assembly_instance_name);
         }
         else
         {
-            // Check if we already generated the corresponding appleseed objects.
-            const ObjectMap::const_iterator it = object_map.find(object);
-            if (it == object_map.end())
-            {
-                // The appleseed objects do not exist yet, create and instantiate them.
-                const auto object_infos = create_mesh_objects(assembly, node, time);
-                object_map.insert(std::make_pair(object, object_infos));
-
-                for (const auto& object_info : object_infos)
-                {
-                    create_object_instance(
-                        assembly,
-                        node,
-                        transform,
-                        object_info,
-                        type,
-                        use_max_proc_maps,
-                        time,
-                        material_map);
-                }
-            }
-            else
+            for (const auto& object_info : object_infos)
             {
-                // The appleseed objects already exist, simply instantiate them.
-                for (const auto& object_info : it->second)
-                {
+                node_instances.m_object_instance_names.push_back(
                     create_object_instance(
                         assembly,
                         node,
@@ -733,8 +1209,7 @@ namespace
                         type,
                         use_max_proc_maps,
                         time,
-                        material_map);
-                }
+                        material_map));
             }
         }
     }
@@ -745,27 +1220,60 @@ namespace
         const RenderType        type,
         const bool              use_max_proc_maps,
         const TimeValue         time,
+        const size_t            thread_count,
+        GeometryCache*          geometry_cache,
         ObjectMap&              object_map,
         MaterialMap&            material_map,
         AssemblyMap&            assembly_map,
+        InstanceMap&            instance_map,
         RendProgressCallback*   progress_cb)
     {
+        const int total = static_cast<int>(entities.m_objects.size());
+
+        // Retrieve 3ds Max meshes and create empty appleseed objects.
+        // The 3ds Max API is not thread-safe, this must happen on the main thread.
+        std::vector<PendingMesh> pending_meshes;
         for (size_t i = 0, e = entities.m_objects.size(); i < e; ++i)
         {
-            const auto& object = entities.m_objects[i];
-            add_object(
+            prepare_object(
                 assembly,
-                object,
+                entities.m_objects[i],
+                time,
+                object_map,
+                assembly_map,
+                pending_meshes);
+
+            const int done = static_cast<int>(i);
+            if (progress_cb->Progress(done + 1, 3 * total) == RENDPROG_ABORT)
+            {
+                release_pending_meshes(pending_meshes);
+                return;
+            }
+        }
+
+        // Convert 3ds Max meshes to appleseed objects in parallel.
+        if (!convert_pending_meshes(pending_meshes, time, thread_count, geometry_cache, progress_cb, total))
+            return;
+
+        // Share appleseed objects between 3ds Max objects with identical geometry.
+        share_identical_objects(assembly, entities, time, object_map, assembly_map);
+
+        // Create object instances and materials, in scene order.
+        for (size_t i = 0, e = entities.m_objects.size(); i < e; ++i)
+        {
+            instantiate_object(
+                assembly,
+                entities.m_objects[i],
                 type,
                 use_max_proc_maps,
                 time,
                 object_map,
                 material_map,
-                assembly_map);
+                assembly_map,
+                instance_map);
 
             const int done = static_cast<int>(i);
-            const int total = static_cast<int>(e);
-            if (progress_cb->Progress(done + 1, total) == RENDPROG_ABORT)
+            if (progress_cb->Progress(2 * total + done + 1, 3 * total) == RENDPROG_ABORT)
                 break;
         }
     }
@@ -1066,7 +1574,7 @@ namespace
     {
         for (const auto& entry : material_map)
         {
-            Mtl* mtl = entry.first;
+            Mtl* mtl = entry.first.second;
             if (is_light_emitting_material(mtl))
                 return true;
         }
@@ -1082,12 +1590,14 @@ namespace
         const std::vector<DefaultLight>&    default_lights,
         const RenderType                    type,
         const RendererSettings&             settings,
+        GeometryCache*                      geometry_cache,
+        MaterialMap&                        material_map,
+        InstanceMap&                        instance_map,
         const TimeValue                     time,
         RendProgressCallback*               progress_cb)
     {
         // Add objects, object instances and materials to the assembly.
         ObjectMap object_map;
-        MaterialMap material_map;
         AssemblyMap assembly_map;
         add_objects(
             assembly,
@@ -1095,9 +1605,12 @@ namespace
             type,
             settings.m_use_max_procedural_maps,
             time,
+            get_thread_count(settings.m_rendering_threads),
+            geometry_cache,
             object_map,
             material_map,
             assembly_map,
+            instance_map,
             progress_cb);
 
         // Only add non-physical lights. Light-emitting materials were added by material plugins.
@@ -1163,10 +1676,206 @@ namespace
         }
     }
 
+    bool compute_reference_signature(
+        ReferenceTarget*        target,
+        const TimeValue         time,
+        asf::uint64&            signature);
+
+    // Hash the last write time and the size of a file, so that signatures change when
+    // a file is overwritten under the same name. Missing files are hashed as such.
+    void hash_file_attributes(
+        const MCHAR*            path,
+        asf::uint64&            signature)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        const bool exists = GetFileAttributesExW(path, GetFileExInfoStandard, &data) != 0;
+        signature = hash_bytes(&exists, sizeof(exists), signature);
+
+        if (exists)
+        {
+            signature = hash_bytes(&data.ftLastWriteTime, sizeof(data.ftLastWriteTime), signature);
+            signature = hash_bytes(&data.nFileSizeHigh, sizeof(data.nFileSizeHigh), signature);
+            signature = hash_bytes(&data.nFileSizeLow, sizeof(data.nFileSizeLow), signature);
+        }
+    }
+
+    // Compute a hash of the parameters of a parameter block at a given time.
+    // Return false if the parameter block has parameters that can't be hashed.
+    bool compute_param_block_signature(
+        IParamBlock2*           pblock,
+        const TimeValue         time,
+        asf::uint64&            signature)
+    {
+        for (int i = 0, ie = pblock->NumParams(); i < ie; ++i)
+        {
+            const ParamID id = pblock->IndextoID(i);
+            const ParamType2 type = pblock->GetParameterType(id);
+            const int count = is_tab(type) ? pblock->Count(id) : 1;
+            signature = hash_bytes(&count, sizeof(count), signature);
+
+            for (int j = 0; j < count; ++j)
+            {
+                switch (base_type(type))
+                {
+                  case TYPE_FLOAT:
+                  case TYPE_ANGLE:
+                  case TYPE_PCNT_FRAC:
+                  case TYPE_WORLD:
+                  case TYPE_COLOR_CHANNEL:
+                    {
+                        const float value = pblock->GetFloat(id, time, j);
+                        signature = hash_bytes(&value, sizeof(value), signature);
+                    }
+                    break;
+
+                  case TYPE_INT:
+                  case TYPE_BOOL:
+                  case TYPE_RADIOBTN_INDEX:
+                  case TYPE_TIMEVALUE:
+                    {
+                        const int value = pblock->GetInt(id, time, j);
+                        signature = hash_bytes(&value, sizeof(value), signature);
+                    }
+                    break;
+
+                  case TYPE_RGBA:
+                    {
+                        const Color value = pblock->GetColor(id, time, j);
+                        signature = hash_bytes(&value, sizeof(value), signature);
+                    }
+                    break;
+
+                  case TYPE_POINT3:
+                    {
+                        const Point3 value = pblock->GetPoint3(id, time, j);
+                        signature = hash_bytes(&value, sizeof(value), signature);
+                    }
+                    break;
+
+                  case TYPE_FRGBA:
+                    {
+                        const AColor value = pblock->GetAColor(id, time, j);
+                        signature = hash_bytes(&value, sizeof(value), signature);
+                    }
+                    break;
+
+                  case TYPE_STRING:
+                    {
+                        const MCHAR* value = pblock->GetStr(id, time, j);
+                        if (value != nullptr)
+                            signature = hash_bytes(value, wcslen(value) * sizeof(MCHAR), signature);
+                    }
+                    break;
+
+                  case TYPE_FILENAME:
+                    {
+                        const MCHAR* value = pblock->GetStr(id, time, j);
+                        if (value != nullptr)
+                        {
+                            signature = hash_bytes(value, wcslen(value) * sizeof(MCHAR), signature);
+                            hash_file_attributes(value, signature);
+                        }
+                    }
+                    break;
+
+                  case TYPE_BITMAP:
+                    {
+                        const PBBitmap* value = pblock->GetBitmap(id, time, j);
+                        const MCHAR* filename = value != nullptr ? value->bi.Name() : nullptr;
+                        if (filename != nullptr)
+                        {
+                            signature = hash_bytes(filename, wcslen(filename) * sizeof(MCHAR), signature);
+                            hash_file_attributes(filename, signature);
+                        }
+                    }
+                    break;
+
+                  case TYPE_TEXMAP:
+                    {
+                        Texmap* value = pblock->GetTexmap(id, time, j);
+                        const bool has_texmap = value != nullptr;
+                        signature = hash_bytes(&has_texmap, sizeof(has_texmap), signature);
+
+                        if (has_texmap && !compute_reference_signature(value, time, signature))
+                            return false;
+                    }
+                    break;
+
+                  default:
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // Compute a hash of the parameters of an entity at a given time, including the parameters of
+    // everything it references such as sub-texture maps, coordinates generators and texture outputs.
+    // Return false if some of these parameters can't be hashed.
+    bool compute_reference_signature(
+        ReferenceTarget*        target,
+        const TimeValue         time,
+        asf::uint64&            signature)
+    {
+        const SClass_ID super_class_id = target->SuperClassID();
+        if (super_class_id == PARAMETER_BLOCK2_CLASS_ID)
+            return compute_param_block_signature(static_cast<IParamBlock2*>(target), time, signature);
+
+        // Only parameter block 2 parameters are considered, entities storing their parameters
+        // in any other way can't be hashed. Their class ID and validity interval would not reveal
+        // edits of non-animated parameters, hence there is no weaker fallback: texture maps that
+        // reference such entities are simply never reused from a cache.
+        if (target->NumParamBlocks() == 0)
+            return false;
+
+        const Class_ID class_id = target->ClassID();
+        const ULONG class_id_parts[3] = { super_class_id, class_id.PartA(), class_id.PartB() };
+        signature = hash_bytes(class_id_parts, sizeof(class_id_parts), signature);
+
+        for (int i = 0, e = target->NumRefs(); i < e; ++i)
+        {
+            ReferenceTarget* reference = target->GetReference(i);
+            const bool has_reference = reference != nullptr;
+            signature = hash_bytes(&has_reference, sizeof(has_reference), signature);
+
+            if (has_reference && !compute_reference_signature(reference, time, signature))
+                return false;
+        }
+
+        return true;
+    }
+
+    // Return the width of the latitude-longitude image a non-bitmap environment map is baked to.
+    size_t get_envmap_width(
+        const RendererSettings& settings,
+        Bitmap*                 bitmap)
+    {
+        const size_t MinEnvMapWidth = 1024;
+        const size_t MaxEnvMapWidth = 8192;
+
+        if (settings.m_envmap_resolution > 0)
+        {
+            return
+                std::min(
+                    std::max(static_cast<size_t>(settings.m_envmap_resolution), MinEnvMapWidth),
+                    MaxEnvMapWidth);
+        }
+
+        // Match the horizontal resolution of the output, rounded up to a power of two.
+        size_t width = MinEnvMapWidth;
+        while (width < static_cast<size_t>(bitmap->Width()) && width < MaxEnvMapWidth)
+            width *= 2;
+
+        return width;
+    }
+
     void setup_environment_map(
         asr::Scene&             scene,
         const RendParams&       rend_params,
         const RendererSettings& settings,
+        EnvironmentMapCache*    envmap_cache,
+        Bitmap*                 bitmap,
         const TimeValue         time)
     {
         // Create environment EDF.
@@ -1196,36 +1905,53 @@ namespace
             else
             {
                 // Dimensions of the environment map texture.
-                const size_t EnvMapWidth = 2048;
-                const size_t EnvMapHeight = 1024;
-
-                // Render the environment map into a Max bitmap.
-                BitmapInfo bi;
-                bi.SetWidth(static_cast<WORD>(EnvMapWidth));
-                bi.SetHeight(static_cast<WORD>(EnvMapHeight));
-                bi.SetType(BMM_FLOAT_RGBA_32);
-                Bitmap* envmap_bitmap = TheManager->Create(&bi);
-                rend_params.envMap->RenderBitmap(time, envmap_bitmap, 1.0f, TRUE);
-
-                // Render the Max bitmap to an appleseed image.
-                asf::auto_release_ptr<asf::Image> envmap_image =
-                    render_bitmap_to_image(envmap_bitmap, EnvMapWidth, EnvMapHeight, 32, 32);
-
-                // Destroy the Max bitmap.
-                envmap_bitmap->DeleteThis();
-
-                // Write the environment map to disk, useful for debugging.
-                // asf::GenericImageFileWriter writer;
-                // writer.write("appleseed-max-environment-map.exr", envmap_image.ref());
+                const size_t envmap_width = get_envmap_width(settings, bitmap);
+                const size_t envmap_height = envmap_width / 2;
+
+                // Reuse the environment map baked for a previous render if the texture map didn't change.
+                asf::uint64 envmap_signature = 0;
+                const bool cacheable =
+                    envmap_cache != nullptr &&
+                    compute_texmap_signature(rend_params.envMap, time, envmap_signature);
+                if (envmap_cache != nullptr && !cacheable)
+                    RENDERER_LOG_DEBUG("environment map can't be reused across renders since some of its parameters can't be hashed.");
+                EnvironmentMapCache::ImagePtr envmap_image =
+                    cacheable ? envmap_cache->lookup(envmap_signature, envmap_width, envmap_height)
+                              : EnvironmentMapCache::ImagePtr();
+
+                if (envmap_image)
+                {
+                    RENDERER_LOG_DEBUG("reusing environment map baked for a previous render.");
+                }
+                else
+                {
+                    // Render the environment map into a Max bitmap.
+                    BitmapInfo bi;
+                    bi.SetWidth(static_cast<WORD>(envmap_width));
+                    bi.SetHeight(static_cast<WORD>(envmap_height));
+                    bi.SetType(BMM_FLOAT_RGBA_32);
+                    Bitmap* envmap_bitmap = TheManager->Create(&bi);
+                    rend_params.envMap->RenderBitmap(time, envmap_bitmap, 1.0f, TRUE);
+
+                    // Render the Max bitmap to an appleseed image.
+                    envmap_image = make_shared_image(render_bitmap_to_image(envmap_bitmap, envmap_width, envmap_height, 32, 32));
+
+                    // Destroy the Max bitmap.
+                    envmap_bitmap->DeleteThis();
+
+                    // Write the environment map to disk, useful for debugging.
+                    // asf::GenericImageFileWriter writer;
+                    // writer.write("appleseed-max-environment-map.exr", *envmap_image);
+
+                    if (cacheable)
+                        envmap_cache->insert(envmap_signature, envmap_image);
+                    else if (envmap_cache != nullptr)
+                        envmap_cache->clear();
+                }
 
+                // The texture shares the image with the cache.
                 const std::string env_tex_name = make_unique_name(scene.textures(), "environment_map");
-                scene.textures().insert(
-                    asf::auto_release_ptr<asr::Texture>(
-                        asr::MemoryTexture2dFactory().create(
-                            env_tex_name.c_str(),
-                            asr::ParamArray()
-                                .insert("color_space", "linear_rgb"),
-                            envmap_image)));
+                scene.textures().insert(create_shared_image_texture(env_tex_name.c_str(), envmap_image));
 
                 env_tex_instance_name = make_unique_name(scene.texture_instances(), "environment_map_inst");
                 scene.texture_instances().insert(
@@ -1359,13 +2085,15 @@ namespace
         const RendParams&       rend_params,
         const FrameRendParams&  frame_rend_params,
         const RendererSettings& settings,
+        EnvironmentMapCache*    envmap_cache,
+        Bitmap*                 bitmap,
         const TimeValue         time)
     {
         if (rend_params.envMap != nullptr)
         {
             if (rend_params.inMtlEdit)
                 setup_material_editor_environment_map(scene, rend_params, time);
-            else setup_environment_map(scene, rend_params, settings, time);
+            else setup_environment_map(scene, rend_params, settings, envmap_cache, bitmap, time);
         }
         else setup_solid_environment(scene, frame_rend_params, settings);
     }
@@ -1594,10 +2322,20 @@ asf::auto_release_ptr<asr::Project> build_project(
     const RendParams&                       rend_params,
     const FrameRendParams&                  frame_rend_params,
     const RendererSettings&                 settings,
+    GeometryCache*                          geometry_cache,
+    EnvironmentMapCache*                    envmap_cache,
+    MaterialMap*                            material_map,
+    InstanceMap*                            instance_map,
     Bitmap*                                 bitmap,
     const TimeValue                         time,
     RendProgressCallback*                   progress_cb)
 {
+    // Speed up unique name generation while building the project.
+    UniqueNameRegistry unique_name_registry;
+
+    // Share shader groups between materials with identical shading networks.
+    ShaderGroupRegistry shader_group_registry(time);
+
     // Create an empty project.
     asf::auto_release_ptr<asr::Project> project(
         asr::ProjectFactory::create("project"));
@@ -1619,6 +2357,8 @@ asf::auto_release_ptr<asr::Project> build_project(
         rend_params,
         frame_rend_params,
         settings,
+        envmap_cache,
+        bitmap,
         time);
 
     // Create an assembly.
@@ -1628,6 +2368,8 @@ asf::auto_release_ptr<asr::Project> build_project(
     // Populate the assembly with entities from the 3ds Max scene.
     const RenderType type =
         rend_params.inMtlEdit ? RenderType::MaterialPreview : RenderType::Default;
+    MaterialMap local_material_map;
+    InstanceMap local_instance_map;
     populate_assembly(
         scene.ref(),
         assembly.ref(),
@@ -1636,6 +2378,9 @@ asf::auto_release_ptr<asr::Project> build_project(
         default_lights,
         type,
         settings,
+        geometry_cache,
+        material_map != nullptr ? *material_map : local_material_map,
+        instance_map != nullptr ? *instance_map : local_instance_map,
         time,
         progress_cb);
 
@@ -1671,5 +2416,49 @@ asf::auto_release_ptr<asr::Project> build_project(
     // Apply renderer settings.
     settings.apply(project.ref());
 
+    if (shader_group_registry.get_shared_group_count() > 0)
+    {
+        RENDERER_LOG_INFO(
+            "shared shader groups between identical materials, saving %s shader group(s).",
+            asf::pretty_uint(shader_group_registry.get_shared_group_count()).c_str());
+    }
+
     return project;
 }
+
+asf::Transformd get_node_transform(
+    INode*                                  node,
+    const TimeValue                         time)
+{
+    return
+        asf::Transformd::from_local_to_parent(
+            to_matrix4d(node->GetObjTMAfterWSM(time)));
+}
+
+bool compute_texmap_signature(
+    Texmap*                                 texmap,
+    const TimeValue                         time,
+    asf::uint64&                            signature)
+{
+    signature = hash_bytes(nullptr, 0);
+    return compute_reference_signature(texmap, time, signature);
+}
+
+void rebuild_material(
+    asr::Assembly&                          assembly,
+    Mtl*                                    mtl,
+    const std::string&                      name,
+    const bool                              use_max_procedural_maps,
+    const TimeValue                         time)
+{
+    auto appleseed_mtl =
+        static_cast<IAppleseedMtl*>(mtl->GetInterface(IAppleseedMtl::interface_id()));
+    if (appleseed_mtl == nullptr)
+        return;
+
+    // Build shading networks at the time being rendered.
+    ShaderGroupRegistry shader_group_registry(time);
+
+    assembly.materials().insert(
+        appleseed_mtl->create_material(assembly, name.c_str(), use_max_procedural_maps));
+}
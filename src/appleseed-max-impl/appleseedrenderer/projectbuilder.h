@@ -29,6 +29,8 @@
 #pragma once
 
 // appleseed.foundation headers.
+#include "foundation/math/transform.h"
+#include "foundation/platform/types.h"
 #include "foundation/platform/windows.h"    // include before 3ds Max headers
 #include "foundation/utility/autoreleaseptr.h"
 
@@ -40,20 +42,48 @@
 #endif
 
 // Standard headers.
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
 // Forward declarations.
+namespace renderer { class Assembly; }
 namespace renderer { class Camera; }
 namespace renderer { class ParamArray; }
 namespace renderer { class Project; }
 class Bitmap;
+class EnvironmentMapCache;
 class FrameRendParams;
+class GeometryCache;
 class MaxSceneEntities;
+class Mtl;
 class RendererSettings;
 class RendParams;
+class Texmap;
 class ViewParams;
 
+// Map a 3ds Max material to the appleseed material created for it in a given assembly.
+// Materials are created per assembly since an assembly can't see the materials of its children.
+typedef std::map<std::pair<renderer::Assembly*, Mtl*>, std::string> MaterialMap;
+
+// Object instances and assembly instances created for a 3ds Max node in a given assembly.
+// Their transform is the object-to-world transform of the node.
+struct NodeInstances
+{
+    renderer::Assembly*                 m_assembly;
+    std::vector<std::string>            m_object_instance_names;
+    std::vector<std::string>            m_assembly_instance_names;
+};
+
+typedef std::map<INode*, NodeInstances> InstanceMap;
+
 // Build an appleseed project from the current 3ds Max scene.
+// Converted geometry is reused from and added to `geometry_cache` unless it is null. The cache
+// lends its objects to the project, see GeometryCache::reclaim().
+// Likewise, baked environment maps are reused from and added to `envmap_cache`.
+// The materials created for 3ds Max materials are recorded in `material_map` unless it is null.
+// Likewise, the instances created for 3ds Max nodes are recorded in `instance_map`.
 foundation::auto_release_ptr<renderer::Project> build_project(
     const MaxSceneEntities&             entities,
     const std::vector<DefaultLight>&    default_lights,
@@ -62,10 +92,40 @@ foundation::auto_release_ptr<renderer::Project> build_project(
     const RendParams&                   rend_params,
     const FrameRendParams&              frame_rend_params,
     const RendererSettings&             settings,
+    GeometryCache*                      geometry_cache,
+    EnvironmentMapCache*                envmap_cache,
+    MaterialMap*                        material_map,
+    InstanceMap*                        instance_map,
     Bitmap*                             bitmap,
     const TimeValue                     time,
     RendProgressCallback*               progress_cb);
 
+// Return the transform of the instances created for a 3ds Max node.
+foundation::Transformd get_node_transform(
+    INode*                              node,
+    const TimeValue                     time);
+
+// Compute a hash of the parameters of a texture map at a given time, including the parameters of
+// everything it references and the last write time and size of the files it uses. Return false if
+// some of these parameters can't be hashed, in which case changes to the texture map can't be
+// detected by comparing signatures. This is the case of texture maps referencing entities that
+// don't store their parameters in parameter blocks 2.
+bool compute_texmap_signature(
+    Texmap*                             texmap,
+    const TimeValue                     time,
+    foundation::uint64&                 signature);
+
+// Create the appleseed material of a 3ds Max material again under a given name, typically the
+// name recorded in the material map by build_project(). The material is inserted into `assembly`
+// together with the entities it depends on, such as shader groups and textures. Shading networks
+// are built at `time`.
+void rebuild_material(
+    renderer::Assembly&                 assembly,
+    Mtl*                                mtl,
+    const std::string&                  name,
+    const bool                          use_max_procedural_maps,
+    const TimeValue                     time);
+
 #if MAX_RELEASE >= 18000
 
 void set_camera_dof_params(
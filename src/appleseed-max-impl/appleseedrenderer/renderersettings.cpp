@@ -64,6 +64,7 @@ namespace
             m_background_emits_light = true;
             m_background_alpha = 0.0f;
             m_force_off_default_lights = false;
+            m_envmap_resolution = 0;        // width of baked environment maps, 0 = derived from output resolution
 
             m_output_mode = OutputMode::RenderOnly;
             m_scale_multiplier = 1.0f;
@@ -78,6 +79,8 @@ namespace
 
             m_enable_render_stamp = false;
             m_render_stamp_format = L"appleseed {lib-version} | Time: {render-time}";
+
+            m_geometry_cache_size = 1024;   // in megabytes, 0 = disabled
         }
     };
 }
@@ -214,6 +217,10 @@ bool RendererSettings::save(ISave* isave) const
         success &= write<bool>(isave, m_force_off_default_lights);
         isave->EndChunk();
 
+        isave->BeginChunk(ChunkSettingsLightingEnvMapResolution);
+        success &= write<int>(isave, m_envmap_resolution);
+        isave->EndChunk();
+
     isave->EndChunk();
 
     //
@@ -272,6 +279,10 @@ bool RendererSettings::save(ISave* isave) const
         isave->BeginChunk(ChunkSettingsSystemRenderStampString);
         success &= write(isave, m_render_stamp_format);
         isave->EndChunk();
+
+        isave->BeginChunk(ChunkSettingsSystemGeometryCacheSize);
+        success &= write<int>(isave, m_geometry_cache_size);
+        isave->EndChunk();
         
     isave->EndChunk();
 
@@ -411,6 +422,10 @@ IOResult RendererSettings::load_lighting_settings(ILoad* iload)
           case ChunkSettingsLightingForceOffDefaultLights:
             result = read<bool>(iload, &m_force_off_default_lights);
             break;
+
+          case ChunkSettingsLightingEnvMapResolution:
+            result = read<int>(iload, &m_envmap_resolution);
+            break;
         }
 
         if (result != IO_OK)
@@ -516,6 +531,10 @@ IOResult RendererSettings::load_system_settings(ILoad* iload)
           case ChunkSettingsSystemRenderStampString:
             result = read(iload, &m_render_stamp_format);
             break;
+
+          case ChunkSettingsSystemGeometryCacheSize:
+            result = read<int>(iload, &m_geometry_cache_size);
+            break;
         }
 
         if (result != IO_OK)
@@ -78,6 +78,7 @@ class RendererSettings
     bool        m_background_emits_light;
     float       m_background_alpha;
     bool        m_force_off_default_lights;
+    int         m_envmap_resolution;
 
     //
     // Output.
@@ -105,6 +106,7 @@ class RendererSettings
     bool                        m_log_material_editor_messages;
     bool                        m_enable_render_stamp;
     MSTR                        m_render_stamp_format;
+    int                         m_geometry_cache_size;
 
     // Apply these settings to a given project.
     void apply(renderer::Project& project) const;
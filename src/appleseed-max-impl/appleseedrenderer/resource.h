@@ -33,6 +33,9 @@
 #define IDC_TEXT_BACKGROUND_ALPHA                   311
 #define IDC_SPINNER_BACKGROUND_ALPHA                312
 #define IDC_CHECK_FORCE_OFF_DEFAULT_LIGHT           313
+#define IDC_STATIC_ENVMAP_RESOLUTION                314
+#define IDC_TEXT_ENVMAP_RESOLUTION                  315
+#define IDC_SPINNER_ENVMAP_RESOLUTION               316
 
 #define IDD_FORMVIEW_RENDERERPARAMS_OUTPUT          400
 #define IDC_RADIO_RENDER                            401
@@ -51,6 +54,9 @@
 #define IDC_CHECK_LOW_PRIORITY_MODE                 503
 #define IDC_CHECK_USE_MAX_PROCEDURAL_MAPS           504
 #define IDC_CHECK_LOG_MATERIAL_EDITOR               505
+#define IDC_STATIC_GEOMETRY_CACHE_SIZE              506
+#define IDC_TEXT_GEOMETRY_CACHE_SIZE                507
+#define IDC_SPINNER_GEOMETRY_CACHE_SIZE             508
 
 #define IDD_DIALOG_LOG                              600
 #define IDC_COMBO_LOG                               601
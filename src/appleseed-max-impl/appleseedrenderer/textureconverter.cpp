@@ -0,0 +1,450 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2018 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "textureconverter.h"
+
+// appleseed-max headers.
+#include "utilities.h"
+
+// appleseed.renderer headers.
+#include "renderer/api/log.h"
+#include "renderer/api/project.h"
+#include "renderer/api/scene.h"
+#include "renderer/api/shadergroup.h"
+#include "renderer/api/texture.h"
+
+// appleseed.foundation headers.
+#include "foundation/utility/autoreleaseptr.h"
+#include "foundation/utility/searchpaths.h"
+#include "foundation/utility/string.h"
+
+// 3ds Max headers.
+#include <assert1.h>
+#include <IPathConfigMgr.h>
+#include <maxapi.h>
+
+// Standard headers.
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace asf = foundation;
+namespace asr = renderer;
+
+namespace
+{
+    // Return the lowercase extension of a path, including the dot.
+    std::string get_extension(const std::string& filepath)
+    {
+        const size_t dot = filepath.find_last_of('.');
+        const size_t sep = filepath.find_last_of("\\/");
+        if (dot == std::string::npos || (sep != std::string::npos && dot < sep))
+            return std::string();
+        return asf::lower_case(filepath.substr(dot));
+    }
+
+    bool is_convertible_image_file(const std::string& filepath)
+    {
+        static const char* Extensions[] =
+        {
+            ".bmp", ".exr", ".hdr", ".jpeg", ".jpg", ".png", ".tga", ".tif", ".tiff"
+        };
+
+        const std::string ext = get_extension(filepath);
+        for (const char* e : Extensions)
+        {
+            if (ext == e)
+                return true;
+        }
+
+        return false;
+    }
+
+    bool file_exists(const std::string& filepath)
+    {
+        const DWORD attributes = GetFileAttributesW(utf8_to_wide(filepath).c_str());
+        return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+    }
+
+    //
+    // An image file referenced by the project, and the path of its converted version.
+    //
+
+    struct TextureFile
+    {
+        std::string     m_source_path;
+        std::string     m_converted_path;
+        bool            m_converted;
+    };
+
+    typedef std::map<std::string, TextureFile> TextureFileMap;     // normalized source path -> file
+
+    void add_texture_file(TextureFileMap& files, const std::string& filepath)
+    {
+        if (filepath.empty() || !is_convertible_image_file(filepath))
+            return;
+
+        const std::string normalized_path = normalize_path(filepath);
+        if (files.find(normalized_path) != files.end())
+            return;
+
+        TextureFile file;
+        file.m_source_path = filepath;
+        file.m_converted = false;
+        files.insert(std::make_pair(normalized_path, file));
+    }
+
+    // Return the file path held by an OSL string parameter value, or an empty string.
+    std::string get_osl_string_value(const char* value)
+    {
+        static const char Prefix[] = "string ";
+        return std::strncmp(value, Prefix, sizeof(Prefix) - 1) == 0
+            ? std::string(value + sizeof(Prefix) - 1)
+            : std::string();
+    }
+
+    void collect_texture_files(const asr::BaseGroup& base_group, TextureFileMap& files)
+    {
+        for (const asr::Texture& texture : base_group.textures())
+        {
+            if (std::strcmp(texture.get_model(), asr::DiskTexture2dFactory().get_model()) == 0 &&
+                texture.get_parameters().strings().exist("filename"))
+                add_texture_file(files, texture.get_parameters().get("filename"));
+        }
+
+        for (const asr::ShaderGroup& shader_group : base_group.shader_groups())
+        {
+            for (const asr::Shader& shader : shader_group.shaders())
+            {
+                const asf::StringDictionary& params = shader.get_parameters().strings();
+                for (auto i = params.begin(), e = params.end(); i != e; ++i)
+                    add_texture_file(files, get_osl_string_value(i.value()));
+            }
+        }
+
+        for (const asr::Assembly& assembly : base_group.assemblies())
+            collect_texture_files(assembly, files);
+    }
+
+    // Return the converted path of a file, or nullptr if the file was not converted.
+    const std::string* find_converted_path(const TextureFileMap& files, const std::string& filepath)
+    {
+        const auto it = files.find(normalize_path(filepath));
+        return it != files.end() && it->second.m_converted ? &it->second.m_converted_path : nullptr;
+    }
+
+    void rewrite_texture_files(asr::BaseGroup& base_group, const TextureFileMap& files)
+    {
+        // Disk textures load their file when they are created, hence they are recreated.
+        std::vector<asr::Texture*> textures;
+        for (asr::Texture& texture : base_group.textures())
+            textures.push_back(&texture);
+
+        for (asr::Texture* texture : textures)
+        {
+            if (std::strcmp(texture->get_model(), asr::DiskTexture2dFactory().get_model()) != 0 ||
+                !texture->get_parameters().strings().exist("filename"))
+                continue;
+
+            const std::string* converted_path =
+                find_converted_path(files, texture->get_parameters().get("filename"));
+            if (converted_path == nullptr)
+                continue;
+
+            asr::ParamArray params = texture->get_parameters();
+            params.insert("filename", *converted_path);
+
+            const std::string texture_name = texture->get_name();
+            base_group.textures().remove(texture);
+            base_group.textures().insert(
+                asr::DiskTexture2dFactory().create(
+                    texture_name.c_str(),
+                    params,
+                    asf::SearchPaths()));
+        }
+
+        // Shaders parse their parameters when they are created, hence shader groups are rebuilt.
+        std::vector<asr::ShaderGroup*> shader_groups;
+        for (asr::ShaderGroup& shader_group : base_group.shader_groups())
+            shader_groups.push_back(&shader_group);
+
+        for (asr::ShaderGroup* shader_group : shader_groups)
+        {
+            bool rewritten = false;
+            asf::auto_release_ptr<asr::ShaderGroup> new_shader_group(
+                asr::ShaderGroupFactory::create(shader_group->get_name()));
+
+            for (const asr::Shader& shader : shader_group->shaders())
+            {
+                asr::ParamArray params = shader.get_parameters();
+                const asf::StringDictionary& strings = shader.get_parameters().strings();
+                for (auto i = strings.begin(), e = strings.end(); i != e; ++i)
+                {
+                    const std::string* converted_path =
+                        find_converted_path(files, get_osl_string_value(i.value()));
+                    if (converted_path != nullptr)
+                    {
+                        params.insert(i.key(), "string " + *converted_path);
+                        rewritten = true;
+                    }
+                }
+
+                new_shader_group->add_shader(
+                    shader.get_type(),
+                    shader.get_shader(),
+                    shader.get_layer(),
+                    params);
+            }
+
+            if (!rewritten)
+                continue;
+
+            for (const asr::ShaderConnection& connection : shader_group->shader_connections())
+            {
+                new_shader_group->add_connection(
+                    connection.get_src_layer(),
+                    connection.get_src_param(),
+                    connection.get_dst_layer(),
+                    connection.get_dst_param());
+            }
+
+            base_group.shader_groups().remove(shader_group);
+            base_group.shader_groups().insert(new_shader_group);
+        }
+
+        for (asr::Assembly& assembly : base_group.assemblies())
+            rewrite_texture_files(assembly, files);
+    }
+
+    // Compute the path of the converted version of a file. Return false if the file doesn't exist.
+    bool get_converted_path(
+        const TextureConversionSettings&    settings,
+        const std::string&                  source_path,
+        std::string&                        converted_path)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExW(utf8_to_wide(source_path).c_str(), GetFileExInfoStandard, &data))
+            return false;
+
+        const std::string normalized_path = normalize_path(source_path);
+        asf::uint64 h = hash_bytes(normalized_path.c_str(), normalized_path.size());
+        h = hash_bytes(&data.ftLastWriteTime, sizeof(data.ftLastWriteTime), h);
+        h = hash_bytes(&data.nFileSizeHigh, sizeof(data.nFileSizeHigh), h);
+        h = hash_bytes(&data.nFileSizeLow, sizeof(data.nFileSizeLow), h);
+
+        converted_path =
+            asf::format(
+                "{0}\\{1}_{2}.tx",
+                settings.m_cache_directory,
+                get_stem(source_path),
+                to_hex_string(h));
+
+        return true;
+    }
+
+    // Run maketx on a file and wait for it to complete. Return true on success.
+    bool run_maketx(
+        const TextureConversionSettings&    settings,
+        const std::string&                  source_path,
+        const std::string&                  output_path)
+    {
+        std::wstring command_line =
+            utf8_to_wide(
+                asf::format(
+                    "\"{0}\" --oiio -o \"{1}\" \"{2}\"",
+                    settings.m_maketx_path,
+                    output_path,
+                    source_path));
+
+        STARTUPINFOW startup_info;
+        ZeroMemory(&startup_info, sizeof(startup_info));
+        startup_info.cb = sizeof(startup_info);
+
+        PROCESS_INFORMATION process_info;
+        ZeroMemory(&process_info, sizeof(process_info));
+
+        if (!CreateProcessW(
+                nullptr,
+                &command_line[0],
+                nullptr,
+                nullptr,
+                FALSE,
+                CREATE_NO_WINDOW,
+                nullptr,
+                nullptr,
+                &startup_info,
+                &process_info))
+            return false;
+
+        WaitForSingleObject(process_info.hProcess, INFINITE);
+
+        DWORD exit_code = 1;
+        GetExitCodeProcess(process_info.hProcess, &exit_code);
+
+        CloseHandle(process_info.hThread);
+        CloseHandle(process_info.hProcess);
+
+        return exit_code == 0;
+    }
+
+    // Convert a file unless a converted version already exists in the cache.
+    void convert_texture_file(
+        const TextureConversionSettings&    settings,
+        TextureFile&                        file)
+    {
+        std::string converted_path;
+        if (!get_converted_path(settings, file.m_source_path, converted_path))
+        {
+            RENDERER_LOG_WARNING("could not convert texture file %s: file not found.", file.m_source_path.c_str());
+            return;
+        }
+
+        if (!file_exists(converted_path))
+        {
+            // Write to a temporary file first so that an interrupted conversion never
+            // leaves an incomplete file in the cache.
+            std::stringstream sstr;
+            sstr << converted_path << "." << std::this_thread::get_id() << ".tmp";
+            const std::string temporary_path = sstr.str();
+
+            if (!run_maketx(settings, file.m_source_path, temporary_path))
+            {
+                DeleteFileW(utf8_to_wide(temporary_path).c_str());
+                RENDERER_LOG_WARNING("could not convert texture file %s.", file.m_source_path.c_str());
+                return;
+            }
+
+            // Another render may have converted the same file in the meantime.
+            if (!MoveFileExW(utf8_to_wide(temporary_path).c_str(), utf8_to_wide(converted_path).c_str(), 0))
+            {
+                DeleteFileW(utf8_to_wide(temporary_path).c_str());
+                if (!file_exists(converted_path))
+                {
+                    RENDERER_LOG_WARNING("could not write texture file %s.", converted_path.c_str());
+                    return;
+                }
+            }
+
+            RENDERER_LOG_DEBUG("converted texture file %s to %s.", file.m_source_path.c_str(), converted_path.c_str());
+        }
+
+        file.m_converted_path = converted_path;
+        file.m_converted = true;
+    }
+}
+
+TextureConversionSettings TextureConversionSettings::load(const size_t thread_count)
+{
+    const std::string default_cache_directory =
+        wide_to_utf8(GetCOREInterface()->GetDir(APP_PLUGCFG_DIR)) + "\\appleseed\\texturecache";
+    const std::string default_maketx_path = get_root_path() + "\\maketx.exe";
+
+    TextureConversionSettings settings;
+    settings.m_cache_directory = load_system_setting(L"TextureCacheDirectory", default_cache_directory);
+    settings.m_maketx_path = load_system_setting(L"MakeTxPath", default_maketx_path);
+    settings.m_thread_count = thread_count;
+
+    return settings;
+}
+
+bool convert_project_textures(
+    asr::Project&                       project,
+    const TextureConversionSettings&    settings,
+    RendProgressCallback*               progress_cb)
+{
+    if (!file_exists(settings.m_maketx_path))
+    {
+        RENDERER_LOG_WARNING(
+            "texture conversion is enabled but %s could not be found, textures will not be converted.",
+            settings.m_maketx_path.c_str());
+        return true;
+    }
+
+    MaxSDK::Util::Path cache_directory(utf8_to_wide(settings.m_cache_directory).c_str());
+    if (!cache_directory.Exists())
+        IPathConfigMgr::GetPathConfigMgr()->CreateDirectoryHierarchy(cache_directory);
+
+    TextureFileMap files;
+    collect_texture_files(*project.get_scene(), files);
+    if (files.empty())
+        return true;
+
+    std::vector<TextureFile*> file_list;
+    for (auto& entry : files)
+        file_list.push_back(&entry.second);
+
+    // Progress is only reported from the calling thread since 3ds Max's UI isn't thread-safe.
+    const std::thread::id calling_thread_id = std::this_thread::get_id();
+    std::atomic<size_t> completed_count(0);
+    std::atomic<bool> aborted(false);
+
+    parallel_for(
+        file_list.size(),
+        settings.m_thread_count,
+        [&](const size_t i)
+        {
+            if (aborted)
+                return;
+
+            convert_texture_file(settings, *file_list[i]);
+            ++completed_count;
+
+            if (progress_cb != nullptr && std::this_thread::get_id() == calling_thread_id)
+            {
+                if (progress_cb->Progress(
+                        static_cast<int>(completed_count),
+                        static_cast<int>(file_list.size())) == RENDPROG_ABORT)
+                    aborted = true;
+            }
+        });
+
+    if (aborted)
+        return false;
+
+    size_t converted_count = 0;
+    for (const TextureFile* file : file_list)
+    {
+        if (file->m_converted)
+            ++converted_count;
+    }
+
+    RENDERER_LOG_INFO(
+        "texture conversion: %s of %s texture file(s) available as tiled, mipmapped files.",
+        asf::pretty_uint(converted_count).c_str(),
+        asf::pretty_uint(file_list.size()).c_str());
+
+    if (converted_count > 0)
+        rewrite_texture_files(*project.get_scene(), files);
+
+    return true;
+}
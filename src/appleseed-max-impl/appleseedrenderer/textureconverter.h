@@ -0,0 +1,69 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2018 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.foundation headers.
+#include "foundation/platform/windows.h"    // include before 3ds Max headers
+
+// 3ds Max headers.
+#include <render.h>
+
+// Standard headers.
+#include <cstddef>
+#include <string>
+
+// Forward declarations.
+namespace renderer { class Project; }
+
+//
+// Conversion of the image files referenced by a project to tiled, mipmapped files.
+//
+// Image files referenced by disk textures and by string parameters of OSL shaders are
+// converted with OpenImageIO's maketx tool and stored in a cache directory. Converted
+// files are named after a hash of the source file path, modification time and size,
+// hence they are reused across renders for as long as the source file doesn't change.
+//
+
+struct TextureConversionSettings
+{
+    std::string     m_cache_directory;      // directory where converted files are stored (UTF-8)
+    std::string     m_maketx_path;          // path to the maketx executable (UTF-8)
+    size_t          m_thread_count;         // maximum number of files converted concurrently
+
+    // Load settings from the plugin's system settings, falling back to defaults.
+    static TextureConversionSettings load(const size_t thread_count);
+};
+
+// Convert the image files referenced by a project and make the project reference the
+// converted files instead. Files that fail to convert keep being referenced as they are.
+// Return false if the conversion was aborted from `progress_cb`.
+bool convert_project_textures(
+    renderer::Project&                  project,
+    const TextureConversionSettings&    settings,
+    RendProgressCallback*               progress_cb);
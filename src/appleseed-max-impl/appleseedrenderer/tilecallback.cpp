@@ -29,6 +29,9 @@
 // Interface header.
 #include "tilecallback.h"
 
+// appleseed-max headers.
+#include "utilities.h"
+
 // appleseed.renderer headers.
 #include "renderer/api/frame.h"
 
@@ -105,6 +108,51 @@ namespace
         draw_vline(bitmap, x + width - 1, y + height - 1, -h, pixel);
     }
 
+    // Write a 4-channel floating point tile into a bitmap, one scanline at a time.
+    // Scanlines of such a tile are contiguous arrays of BMM_Color_fl, so they are
+    // handed over to the bitmap without any further conversion.
+    void put_tile_rows(
+        Bitmap*             bitmap,
+        asf::Tile&          fp_tile,
+        const size_t        dest_x,
+        const size_t        dest_y)
+    {
+        static_assert(
+            sizeof(BMM_Color_fl) == sizeof(asf::Color4f),
+            "BMM_Color_fl is expected to be the same size of foundation::Color4f");
+
+        DbgAssert(fp_tile.get_pixel_format() == asf::PixelFormatFloat);
+        DbgAssert(fp_tile.get_channel_count() == 4);
+
+        const int tile_width = static_cast<int>(fp_tile.get_width());
+        const size_t tile_height = fp_tile.get_height();
+
+        for (size_t y = 0; y < tile_height; ++y)
+        {
+            bitmap->PutPixels(
+                static_cast<int>(dest_x),
+                static_cast<int>(dest_y + y),
+                tile_width,
+                reinterpret_cast<BMM_Color_fl*>(fp_tile.pixel(0, y)));
+        }
+    }
+
+    // Progressive updates only examine one scanline out of that many in each tile.
+    const size_t SampledRowStride = 4;
+
+    // Compute a hash of the scanlines of a tile whose index modulo SampledRowStride is `phase`.
+    asf::uint64 hash_tile_rows(const asf::Tile& tile, const size_t phase)
+    {
+        const size_t row_size = tile.get_width() * tile.get_pixel_size();
+
+        asf::uint64 h = hash_bytes(nullptr, 0);
+
+        for (size_t y = phase; y < tile.get_height(); y += SampledRowStride)
+            h = hash_bytes(tile.pixel(0, y), row_size, h);
+
+        return h;
+    }
+
     RECT make_rect(
         const size_t        x,
         const size_t        y,
@@ -125,6 +173,7 @@ TileCallback::TileCallback(
     volatile asf::uint32*   rendered_tile_count)
   : m_bitmap(bitmap)
   , m_rendered_tile_count(rendered_tile_count)
+  , m_update_count(0)
 {
 }
 
@@ -202,15 +251,64 @@ void TileCallback::on_progressive_frame_update(
     DbgAssert(props.m_canvas_height == m_bitmap->Height());
     DbgAssert(props.m_channel_count == 4);
 
-    // Blit all tiles.
+    // Forget about previous updates if the frame layout changed.
+    if (m_tile_hashes.size() != props.m_tile_count * SampledRowStride)
+    {
+        m_tile_hashes.assign(props.m_tile_count * SampledRowStride, 0);
+        m_tile_hashes_valid.assign(props.m_tile_count * SampledRowStride, false);
+    }
+
+    // Reading all pixels to find the tiles that changed would cost about as much as blitting them.
+    // Instead, each update only hashes the scanlines of a given phase, which rotates from one update
+    // to the next, and compares them with their hash from the last update with the same phase.
+    // A pass adds samples to every pixel of the tiles it renders, so changed tiles are caught right
+    // away in practice; a change confined to scanlines of other phases is shown a few updates late.
+    const size_t phase = m_update_count++ % SampledRowStride;
+
+    // Blit the tiles that changed since the last update and compute
+    // the bounding rectangle of the area that needs to be refreshed.
+    size_t dirty_tile_count = 0;
+    RECT dirty_rect = make_rect(0, 0, 0, 0);
     for (size_t y = 0; y < props.m_tile_count_y; ++y)
     {
         for (size_t x = 0; x < props.m_tile_count_x; ++x)
+        {
+            const asf::Tile& tile = frame->image().tile(x, y);
+            const asf::uint64 tile_hash = hash_tile_rows(tile, phase);
+
+            const size_t hash_index = (y * props.m_tile_count_x + x) * SampledRowStride + phase;
+            if (m_tile_hashes_valid[hash_index] && m_tile_hashes[hash_index] == tile_hash)
+                continue;
+
+            m_tile_hashes[hash_index] = tile_hash;
+            m_tile_hashes_valid[hash_index] = true;
+
             blit_tile(*frame, x, y);
+
+            const RECT tile_rect =
+                make_rect(
+                    x * props.m_tile_width,
+                    y * props.m_tile_height,
+                    tile.get_width(),
+                    tile.get_height());
+
+            if (dirty_tile_count++ == 0)
+                dirty_rect = tile_rect;
+            else
+            {
+                dirty_rect.left = std::min(dirty_rect.left, tile_rect.left);
+                dirty_rect.top = std::min(dirty_rect.top, tile_rect.top);
+                dirty_rect.right = std::max(dirty_rect.right, tile_rect.right);
+                dirty_rect.bottom = std::max(dirty_rect.bottom, tile_rect.bottom);
+            }
+        }
     }
 
-    // Refresh the entire display window.
-    m_bitmap->RefreshWindow();
+    // Refresh the part of the display window that changed.
+    if (dirty_tile_count == props.m_tile_count)
+        m_bitmap->RefreshWindow();
+    else if (dirty_tile_count > 0)
+        m_bitmap->RefreshWindow(&dirty_rect);
 }
 
 void TileCallback::blit_tile(
@@ -240,27 +338,10 @@ void TileCallback::blit_tile(
         asf::PixelFormatFloat,
         m_float_tile_storage->get_storage());
 
-    // Blit the time into the bitmap.
-    const size_t dest_x = tile_x * props.m_tile_width;
-    const size_t dest_y = tile_y * props.m_tile_height;
-    const size_t tile_width = fp_tile.get_width();
-    const size_t tile_height = fp_tile.get_height();
-    for (size_t y = 0; y < tile_height; ++y)
-    {
-        for (size_t x = 0; x < tile_width; ++x)
-        {
-            static_assert(
-                sizeof(BMM_Color_fl) == sizeof(asf::Color4f),
-                "BMM_Color_fl is expected to be the same size of foundation::Color4f");
-
-            asf::Color4f color;
-            fp_tile.get_pixel(x, y, &color.r);
-
-            m_bitmap->PutPixels(
-                static_cast<int>(dest_x + x),
-                static_cast<int>(dest_y + y),
-                1,
-                reinterpret_cast<BMM_Color_fl*>(&color));
-        }
-    }
+    // Blit the tile into the bitmap.
+    put_tile_rows(
+        m_bitmap,
+        fp_tile,
+        tile_x * props.m_tile_width,
+        tile_y * props.m_tile_height);
 }
@@ -38,6 +38,7 @@
 // Standard headers.
 #include <cstddef>
 #include <memory>
+#include <vector>
 
 // Forward declarations.
 namespace renderer  { class Frame; }
@@ -70,6 +71,9 @@ class TileCallback
     Bitmap*                             m_bitmap;
     volatile foundation::uint32*        m_rendered_tile_count;
     std::auto_ptr<foundation::Tile>     m_float_tile_storage;
+    size_t                              m_update_count;         // number of progressive updates so far
+    std::vector<foundation::uint64>     m_tile_hashes;          // hash of each set of sampled scanlines of each tile
+    std::vector<bool>                   m_tile_hashes_valid;
 
     void blit_tile(
         const renderer::Frame&          frame,
@@ -0,0 +1,178 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2018 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "vertextransform.h"
+
+// Standard headers.
+#ifdef APPLESEED_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace asr = renderer;
+
+namespace
+{
+    static_assert(
+        sizeof(Point3) == 3 * sizeof(float) && sizeof(asr::GVector3) == 3 * sizeof(float),
+        "Points are expected to be packed triplets of single precision floats");
+
+    // Transform `count` packed xyz triplets by the 4x3 row-major matrix `m`.
+    // The fourth row (translation) is only applied if `translate` is true.
+    void transform_triplets(
+        const float                 m[4][3],
+        const bool                  translate,
+        const float*                input,
+        const size_t                count,
+        float*                      output)
+    {
+        const float tx = translate ? m[3][0] : 0.0f;
+        const float ty = translate ? m[3][1] : 0.0f;
+        const float tz = translate ? m[3][2] : 0.0f;
+
+        size_t i = 0;
+
+#ifdef APPLESEED_USE_SSE
+
+        const __m128 m00 = _mm_set1_ps(m[0][0]), m01 = _mm_set1_ps(m[0][1]), m02 = _mm_set1_ps(m[0][2]);
+        const __m128 m10 = _mm_set1_ps(m[1][0]), m11 = _mm_set1_ps(m[1][1]), m12 = _mm_set1_ps(m[1][2]);
+        const __m128 m20 = _mm_set1_ps(m[2][0]), m21 = _mm_set1_ps(m[2][1]), m22 = _mm_set1_ps(m[2][2]);
+        const __m128 m30 = _mm_set1_ps(tx), m31 = _mm_set1_ps(ty), m32 = _mm_set1_ps(tz);
+
+        for (; i + 4 <= count; i += 4)
+        {
+            const float* in = input + 3 * i;
+            float* out = output + 3 * i;
+
+            // Load four points: a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3.
+            const __m128 a = _mm_loadu_ps(in);
+            const __m128 b = _mm_loadu_ps(in + 4);
+            const __m128 c = _mm_loadu_ps(in + 8);
+
+            // Convert to structure of arrays.
+            const __m128 x =
+                _mm_shuffle_ps(
+                    _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 3, 0)),      // x0 x1 y1 x2
+                    _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)),      // x2 x2 x3 x3
+                    _MM_SHUFFLE(2, 0, 1, 0));
+            const __m128 y =
+                _mm_shuffle_ps(
+                    _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),      // y0 y0 y1 y1
+                    _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),      // y2 y2 y3 y3
+                    _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 z =
+                _mm_shuffle_ps(
+                    _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),      // z0 z0 z1 z1
+                    _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),      // z2 z2 z3 z3
+                    _MM_SHUFFLE(2, 0, 2, 0));
+
+            // Transform.
+            const __m128 ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_add_ps(_mm_mul_ps(z, m20), m30));
+            const __m128 oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_add_ps(_mm_mul_ps(z, m21), m31));
+            const __m128 oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)), _mm_add_ps(_mm_mul_ps(z, m22), m32));
+
+            // Convert back to packed triplets and store.
+            _mm_storeu_ps(
+                out,
+                _mm_shuffle_ps(
+                    _mm_shuffle_ps(ox, oy, _MM_SHUFFLE(0, 0, 0, 0)),    // x0 x0 y0 y0
+                    _mm_shuffle_ps(oz, ox, _MM_SHUFFLE(1, 1, 0, 0)),    // z0 z0 x1 x1
+                    _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(
+                out + 4,
+                _mm_shuffle_ps(
+                    _mm_shuffle_ps(oy, oz, _MM_SHUFFLE(1, 1, 1, 1)),    // y1 y1 z1 z1
+                    _mm_shuffle_ps(ox, oy, _MM_SHUFFLE(2, 2, 2, 2)),    // x2 x2 y2 y2
+                    _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(
+                out + 8,
+                _mm_shuffle_ps(
+                    _mm_shuffle_ps(oz, ox, _MM_SHUFFLE(3, 3, 2, 2)),    // z2 z2 x3 x3
+                    _mm_shuffle_ps(oy, oz, _MM_SHUFFLE(3, 3, 3, 3)),    // y3 y3 z3 z3
+                    _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+
+#endif
+
+        for (; i < count; ++i)
+        {
+            const float x = input[3 * i + 0];
+            const float y = input[3 * i + 1];
+            const float z = input[3 * i + 2];
+
+            output[3 * i + 0] = x * m[0][0] + y * m[1][0] + z * m[2][0] + tx;
+            output[3 * i + 1] = x * m[0][1] + y * m[1][1] + z * m[2][1] + ty;
+            output[3 * i + 2] = x * m[0][2] + y * m[1][2] + z * m[2][2] + tz;
+        }
+    }
+
+    void get_rows(const Matrix3& transform, float m[4][3])
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            const Point3 row = transform.GetRow(r);
+            m[r][0] = row.x;
+            m[r][1] = row.y;
+            m[r][2] = row.z;
+        }
+    }
+}
+
+void transform_points(
+    const Matrix3&              transform,
+    const Point3*               input,
+    const size_t                count,
+    asr::GVector3*              output)
+{
+    float m[4][3];
+    get_rows(transform, m);
+
+    transform_triplets(
+        m,
+        true,
+        reinterpret_cast<const float*>(input),
+        count,
+        reinterpret_cast<float*>(output));
+}
+
+void transform_vectors(
+    const Matrix3&              transform,
+    const asr::GVector3*        input,
+    const size_t                count,
+    asr::GVector3*              output)
+{
+    float m[4][3];
+    get_rows(transform, m);
+
+    transform_triplets(
+        m,
+        false,
+        reinterpret_cast<const float*>(input),
+        count,
+        reinterpret_cast<float*>(output));
+}
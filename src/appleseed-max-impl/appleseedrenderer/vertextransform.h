@@ -0,0 +1,63 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2018 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// appleseed.renderer headers.
+#include "renderer/api/object.h"
+
+// appleseed.foundation headers.
+#include "foundation/platform/windows.h"    // include before 3ds Max headers
+
+// 3ds Max headers.
+#include <matrix3.h>
+#include <point3.h>
+
+// Standard headers.
+#include <cstddef>
+
+//
+// Batched transformation of vertex arrays.
+//
+// Points are transformed four at a time with SSE when APPLESEED_USE_SSE is defined,
+// one at a time otherwise. Input and output arrays may be the same.
+//
+
+// Transform points by an affine transform (p' = p * transform in 3ds Max's convention).
+void transform_points(
+    const Matrix3&              transform,
+    const Point3*               input,
+    const size_t                count,
+    renderer::GVector3*         output);
+
+// Transform vectors by the linear part of an affine transform, ignoring its translation.
+void transform_vectors(
+    const Matrix3&              transform,
+    const renderer::GVector3*   input,
+    const size_t                count,
+    renderer::GVector3*         output);
@@ -724,7 +724,7 @@ asf::auto_release_ptr<asr::Material> AppleseedSSSMtl::create_osl_material(
         closure2surface_name.c_str(),
         "in_input");
 
-    assembly.shader_groups().insert(shader_group);
+    shader_group_name = insert_shader_group(assembly, shader_group);
 
     //
     // Material.
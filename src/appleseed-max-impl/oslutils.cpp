@@ -37,6 +37,7 @@
 #include "utilities.h"
 
 // appleseed.renderer headers.
+#include "renderer/api/scene.h"
 #include "renderer/api/shadergroup.h"
 #include "renderer/api/utility.h"
 
@@ -51,6 +52,9 @@
 #include <stdmat.h>
 #include <iparamm2.h>
 
+// Standard headers.
+#include <sstream>
+
 namespace asf = foundation;
 namespace asr = renderer;
 
@@ -66,7 +70,7 @@ asr::ParamArray get_uv_params(Texmap* texmap)
         return uv_params;
 
     StdUVGen* std_uv = static_cast<StdUVGen*>(uv_gen);
-    const auto time = GetCOREInterface()->GetTime();
+    const auto time = get_shading_time();
 
     DbgAssert(texmap->MapSlotType(texmap->GetMapChannel()) == MAPSLOT_TEXTURE);
     DbgAssert(static_cast<StdUVGen*>(uv_gen)->GetUVWSource() == UVWSRC_EXPLICIT);
@@ -177,7 +181,7 @@ asr::ParamArray get_output_params(Texmap* texmap)
     if (std_tex_output == nullptr)
         return output_params;
 
-    const auto time = GetCOREInterface()->GetTime();
+    const auto time = get_shading_time();
 
     output_params.insert("in_multiplier", fmt_osl_expr(std_tex_output->GetOutAmt(time)));
     output_params.insert("in_clamp_output", fmt_osl_expr(std_tex_output->GetClamp()));
@@ -527,29 +531,69 @@ void connect_sub_mtl(
     if (!appleseed_mtl)
         return;
 
-    std::string layer_name =
-        make_unique_name(assembly.materials(), asf::format("{0}_{1}_sub_mat", shader_name, mat->GetName()));
-    assembly.materials().insert(appleseed_mtl->create_material(assembly, layer_name.c_str(), false));
+    // Name of the layer of the sub-material's surface shader in the parent shader group.
+    // The handle of the sub-material tells apart different sub-materials with the same name.
+    const std::string layer_name =
+        asf::format("{0}_{1}_sub_mat_{2}", shader_name, mat->GetName(), Animatable::GetHandleByAnim(mat));
+
+    // Retrieve or build the shader group of the sub-material. Only its layers are copied into the
+    // parent shader group, so it is built into an assembly that is not part of the scene. The
+    // material entity itself is not needed.
+    const TimeValue time = get_shading_time();
+    ShaderGroupRegistry* registry = ShaderGroupRegistry::current();
+    asf::auto_release_ptr<asr::Assembly> local_sub_mtl_assembly;
+    const asr::ShaderGroup* mtl_group = nullptr;
+    if (registry != nullptr)
+        mtl_group = registry->get_sub_mtl_shader_group(mat, time);
+    if (mtl_group == nullptr)
+    {
+        if (registry == nullptr)
+            local_sub_mtl_assembly = asr::AssemblyFactory().create("sub_mtl_assembly");
 
-    asr::Material* layer_material = assembly.materials().get_by_name(layer_name.c_str());
-    if (!layer_material->get_parameters().exist_path("osl_surface"))
-        return;
+        asr::Assembly& sub_mtl_assembly =
+            registry != nullptr ? registry->get_sub_mtl_assembly() : local_sub_mtl_assembly.ref();
 
-    auto shader_group_name = layer_material->get_parameters().get("osl_surface");
-    asr::ShaderGroup* mtl_group = assembly.shader_groups().get_by_name(shader_group_name);
+        asf::auto_release_ptr<asr::Material> layer_material =
+            appleseed_mtl->create_material(sub_mtl_assembly, layer_name.c_str(), false);
+        if (!layer_material->get_parameters().exist_path("osl_surface"))
+            return;
 
-    // Don't copy last shader and last connection
-    for (auto shader = mtl_group->shaders().begin(); shader != --(mtl_group->shaders().end()); shader++)
-    {
-        shader_group.add_shader(shader->get_type(), shader->get_shader(), shader->get_layer(), shader->get_parameters());
+        const std::string shader_group_name = layer_material->get_parameters().get("osl_surface");
+        mtl_group = sub_mtl_assembly.shader_groups().get_by_name(shader_group_name.c_str());
+        if (registry != nullptr)
+            registry->set_sub_mtl_shader_group(mat, time, shader_group_name);
     }
+    auto last_conn = mtl_group->shader_connections().get_by_index(mtl_group->shader_connections().size() - 1);
 
-    for (auto conn = mtl_group->shader_connections().begin(); conn != --(mtl_group->shader_connections().end()); conn++)
+    // A sub-material connected to several inputs of the parent shader group is only copied once.
+    if (shader_group.shaders().get_by_name(layer_name.c_str()) == nullptr)
     {
-        shader_group.add_connection(conn->get_src_layer(), conn->get_src_param(), conn->get_dst_layer(), conn->get_dst_param());
+        // The shader group may be shared with other materials, so its layers are renamed after
+        // the sub-material: the surface shader takes the sub-material's name, other layers get
+        // numbered names derived from it.
+        std::map<std::string, std::string> layer_names;
+        layer_names[last_conn->get_src_layer()] = layer_name;
+
+        // Don't copy last shader and last connection
+        for (auto shader = mtl_group->shaders().begin(); shader != --(mtl_group->shaders().end()); shader++)
+        {
+            std::string& new_layer_name = layer_names[shader->get_layer()];
+            if (new_layer_name.empty())
+                new_layer_name = asf::format("{0}_{1}", layer_name, layer_names.size() - 1);
+
+            shader_group.add_shader(shader->get_type(), shader->get_shader(), new_layer_name.c_str(), shader->get_parameters());
+        }
+
+        for (auto conn = mtl_group->shader_connections().begin(); conn != --(mtl_group->shader_connections().end()); conn++)
+        {
+            shader_group.add_connection(
+                layer_names[conn->get_src_layer()].c_str(),
+                conn->get_src_param(),
+                layer_names[conn->get_dst_layer()].c_str(),
+                conn->get_dst_param());
+        }
     }
 
-    auto last_conn = mtl_group->shader_connections().get_by_index(mtl_group->shader_connections().size() - 1);
     shader_group.add_connection(layer_name.c_str(), last_conn->get_src_param(), shader_name, shader_input);
 }
 
@@ -561,7 +605,7 @@ void create_osl_shader(
     const OSLShaderInfo*    shader_info)
 {
     asr::ParamArray params;
-    const auto t = GetCOREInterface()->GetTime();
+    const auto t = get_shading_time();
 
     for (const auto& param_info : shader_info->m_params)
     {
@@ -699,3 +743,137 @@ void create_osl_shader(
 
     shader_group.add_shader("shader", shader_info->m_shader_name.c_str(), layer_name, params);
 }
+
+std::string get_canonical_shader_group_description(const asr::ShaderGroup& shader_group)
+{
+    // Layers are identified by their position in the group.
+    std::map<std::string, size_t> layer_indices;
+    for (const asr::Shader& shader : shader_group.shaders())
+        layer_indices.insert(std::make_pair(std::string(shader.get_layer()), layer_indices.size()));
+
+    const auto get_layer_id = [&layer_indices](const char* layer) -> std::string
+    {
+        const auto it = layer_indices.find(layer);
+        return it != layer_indices.end() ? asf::to_string(it->second) : std::string("?") + layer;
+    };
+
+    std::stringstream sstr;
+
+    for (const asr::Shader& shader : shader_group.shaders())
+    {
+        sstr << "shader " << get_layer_id(shader.get_layer()) << " " << shader.get_type() << " " << shader.get_shader() << "\n";
+
+        const asf::StringDictionary& params = shader.get_parameters().strings();
+        for (auto i = params.begin(), e = params.end(); i != e; ++i)
+            sstr << "  " << i.key() << " = " << i.value() << "\n";
+    }
+
+    for (const asr::ShaderConnection& connection : shader_group.shader_connections())
+    {
+        sstr
+            << "connection "
+            << get_layer_id(connection.get_src_layer()) << "." << connection.get_src_param() << " -> "
+            << get_layer_id(connection.get_dst_layer()) << "." << connection.get_dst_param() << "\n";
+    }
+
+    return sstr.str();
+}
+
+namespace
+{
+    thread_local ShaderGroupRegistry* g_current_shader_group_registry = nullptr;
+}
+
+ShaderGroupRegistry::ShaderGroupRegistry(const TimeValue time)
+  : m_previous(g_current_shader_group_registry)
+  , m_time(time)
+  , m_shared_group_count(0)
+  , m_sub_mtl_assembly(asr::AssemblyFactory().create("sub_mtl_assembly"))
+{
+    g_current_shader_group_registry = this;
+}
+
+ShaderGroupRegistry::~ShaderGroupRegistry()
+{
+    g_current_shader_group_registry = m_previous;
+}
+
+ShaderGroupRegistry* ShaderGroupRegistry::current()
+{
+    return g_current_shader_group_registry;
+}
+
+std::string ShaderGroupRegistry::insert(
+    asr::Assembly&                              assembly,
+    asf::auto_release_ptr<asr::ShaderGroup>     shader_group)
+{
+    const Key key(&assembly, get_canonical_shader_group_description(shader_group.ref()));
+
+    const auto it = m_group_names.find(key);
+    if (it != m_group_names.end())
+    {
+        ++m_shared_group_count;
+        return it->second;
+    }
+
+    const std::string shader_group_name = shader_group->get_name();
+    m_group_names.insert(std::make_pair(key, shader_group_name));
+    assembly.shader_groups().insert(shader_group);
+
+    return shader_group_name;
+}
+
+TimeValue ShaderGroupRegistry::get_time() const
+{
+    return m_time;
+}
+
+size_t ShaderGroupRegistry::get_shared_group_count() const
+{
+    return m_shared_group_count;
+}
+
+asr::Assembly& ShaderGroupRegistry::get_sub_mtl_assembly()
+{
+    return m_sub_mtl_assembly.ref();
+}
+
+const asr::ShaderGroup* ShaderGroupRegistry::get_sub_mtl_shader_group(
+    Mtl*                                        mtl,
+    const TimeValue                             time) const
+{
+    const auto it = m_sub_mtl_group_names.find(SubMtlKey(mtl, time));
+    return
+        it != m_sub_mtl_group_names.end()
+            ? m_sub_mtl_assembly->shader_groups().get_by_name(it->second.c_str())
+            : nullptr;
+}
+
+void ShaderGroupRegistry::set_sub_mtl_shader_group(
+    Mtl*                                        mtl,
+    const TimeValue                             time,
+    const std::string&                          shader_group_name)
+{
+    m_sub_mtl_group_names[SubMtlKey(mtl, time)] = shader_group_name;
+}
+
+TimeValue get_shading_time()
+{
+    if (const ShaderGroupRegistry* registry = ShaderGroupRegistry::current())
+        return registry->get_time();
+
+    return GetCOREInterface()->GetTime();
+}
+
+std::string insert_shader_group(
+    asr::Assembly&                              assembly,
+    asf::auto_release_ptr<asr::ShaderGroup>     shader_group)
+{
+    if (ShaderGroupRegistry* registry = ShaderGroupRegistry::current())
+        return registry->insert(assembly, shader_group);
+
+    const std::string shader_group_name = shader_group->get_name();
+    assembly.shader_groups().insert(shader_group);
+
+    return shader_group_name;
+}
@@ -30,14 +30,19 @@
 
 // appleseed.foundation headers.
 #include "foundation/platform/windows.h"    // include before 3ds Max headers
+#include "foundation/core/concepts/noncopyable.h"
 #include "foundation/image/color.h"
 #include "foundation/math/vector.h"
+#include "foundation/utility/autoreleaseptr.h"
 
 // 3ds Max Headers.
 #include <maxtypes.h>
 
 // Standard headers.
+#include <cstddef>
+#include <map>
 #include <string>
+#include <utility>
 
 // Forward declarations.
 namespace renderer { class Assembly; }
@@ -113,3 +118,72 @@ void create_osl_shader(
     const char*             layer_name,
     IParamBlock2*           param_block,
     const OSLShaderInfo*    shader_info);
+
+// Return a description of the shaders and connections of a shader group that does not depend
+// on the names of the group and of its layers. Identical descriptions mean identical groups.
+std::string get_canonical_shader_group_description(const renderer::ShaderGroup& shader_group);
+
+// While an instance of this class exists, insert_shader_group() calls made from the same thread
+// share shader groups with identical shaders and connections within each assembly, the shader
+// groups of sub-materials are only built once per time by connect_sub_mtl(), and shading networks
+// are built at the time being rendered.
+class ShaderGroupRegistry
+  : public foundation::NonCopyable
+{
+  public:
+    explicit ShaderGroupRegistry(const TimeValue time);
+    ~ShaderGroupRegistry();
+
+    // Return the registry of the calling thread, or nullptr if there is none.
+    static ShaderGroupRegistry* current();
+
+    // Return the time being rendered.
+    TimeValue get_time() const;
+
+    // Insert a shader group into an assembly unless an identical one was already inserted.
+    // Return the name of the shader group that should be referenced.
+    std::string insert(
+        renderer::Assembly&                                 assembly,
+        foundation::auto_release_ptr<renderer::ShaderGroup> shader_group);
+
+    // Return the number of shader groups that were not inserted because an identical one existed.
+    size_t get_shared_group_count() const;
+
+    // Return the assembly the shader groups of sub-materials are built into. This assembly is
+    // not part of any scene, so these shader groups are not rendered nor compiled themselves.
+    renderer::Assembly& get_sub_mtl_assembly();
+
+    // Return the shader group built for a sub-material at a given time,
+    // or nullptr if none was built yet.
+    const renderer::ShaderGroup* get_sub_mtl_shader_group(
+        Mtl*                                mtl,
+        const TimeValue                     time) const;
+
+    // Remember the name of the shader group built for a sub-material at a given time.
+    void set_sub_mtl_shader_group(
+        Mtl*                                mtl,
+        const TimeValue                     time,
+        const std::string&                  shader_group_name);
+
+  private:
+    typedef std::pair<const renderer::Assembly*, std::string> Key;              // assembly, canonical description
+    typedef std::pair<Mtl*, TimeValue> SubMtlKey;
+
+    ShaderGroupRegistry*                                m_previous;
+    const TimeValue                                     m_time;
+    std::map<Key, std::string>                          m_group_names;
+    size_t                                              m_shared_group_count;
+    foundation::auto_release_ptr<renderer::Assembly>    m_sub_mtl_assembly;
+    std::map<SubMtlKey, std::string>                    m_sub_mtl_group_names;
+};
+
+// Return the time shading networks are built at: the time being rendered if a ShaderGroupRegistry
+// is active, the current time of 3ds Max otherwise.
+TimeValue get_shading_time();
+
+// Insert a shader group into an assembly and return the name of the shader group that should be
+// referenced, which is the name of an identical shader group if a ShaderGroupRegistry is active
+// and such a group was already inserted.
+std::string insert_shader_group(
+    renderer::Assembly&                                 assembly,
+    foundation::auto_release_ptr<renderer::ShaderGroup> shader_group);
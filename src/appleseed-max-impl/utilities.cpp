@@ -31,11 +31,14 @@
 
 // appleseed-max headers.
 #include "appleseedoslplugin/osltexture.h"
+#include "appleseedrenderer/projectbuilder.h"
 #include "osloutputselectormap/osloutputselector.h"
 #include "main.h"
+#include "oslutils.h"
 
 // appleseed.renderer headers.
 #include "renderer/api/color.h"
+#include "renderer/api/log.h"
 #include "renderer/api/source.h"
 #include "renderer/api/texture.h"
 
@@ -56,6 +59,18 @@
 #include <plugapi.h>
 #include <stdmat.h>
 
+// Standard headers.
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
 // Windows headers.
 #include <Shlwapi.h>
 
@@ -131,6 +146,20 @@ WStr replace_extension(const WStr& file_path, const WStr& new_ext)
     return new_file_path;
 }
 
+std::string normalize_path(const std::string& file_path)
+{
+    std::string normalized_file_path = asf::lower_case(file_path);
+    std::replace(normalized_file_path.begin(), normalized_file_path.end(), '/', '\\');
+    return normalized_file_path;
+}
+
+std::string get_stem(const std::string& file_path)
+{
+    const size_t begin = file_path.find_last_of("\\/") + 1;
+    const size_t end = file_path.find_last_of('.');
+    return file_path.substr(begin, end != std::string::npos && end > begin ? end - begin : std::string::npos);
+}
+
 void update_map_buttons(IParamMap2* param_map)
 {
     if (param_map == nullptr)
@@ -267,24 +296,34 @@ asf::auto_release_ptr<asf::Image> render_bitmap_to_image(
 
     const asf::CanvasProperties& props = image->properties();
 
+    static_assert(
+        sizeof(BMM_Color_fl) == 4 * sizeof(float),
+        "BMM_Color_fl is expected to be a tightly packed RGBA float color");
+
+    DbgAssert(bitmap->Width() >= static_cast<int>(image_width));
+    DbgAssert(bitmap->Height() >= static_cast<int>(image_height));
+
+    // Read the bitmap one scanline at a time and scatter each scanline into the row of tiles it crosses.
+    std::vector<BMM_Color_fl> scanline(image_width);
     for (size_t ty = 0; ty < props.m_tile_count_y; ++ty)
     {
-        for (size_t tx = 0; tx < props.m_tile_count_x; ++tx)
+        const size_t tile_row_count = image->tile(0, ty).get_height();
+
+        for (size_t y = 0; y < tile_row_count; ++y)
         {
-            asf::Tile& tile = image->tile(tx, ty);
+            bitmap->GetLinearPixels(
+                0,
+                static_cast<int>(ty * props.m_tile_height + y),
+                static_cast<int>(image_width),
+                scanline.data());
 
-            for (size_t y = 0, ye = tile.get_height(); y < ye; ++y)
+            for (size_t tx = 0; tx < props.m_tile_count_x; ++tx)
             {
-                for (size_t x = 0, xe = tile.get_width(); x < xe; ++x)
-                {
-                    const int ix = static_cast<int>(tx * props.m_tile_width + x);
-                    const int iy = static_cast<int>(ty * props.m_tile_height + y);
-
-                    BMM_Color_fl c;
-                    bitmap->GetLinearPixels(ix, iy, 1, &c);
-
-                    tile.set_pixel(x, y, c);
-                }
+                asf::Tile& tile = image->tile(tx, ty);
+                std::memcpy(
+                    tile.pixel(0, y),
+                    &scanline[tx * props.m_tile_width],
+                    tile.get_width() * sizeof(BMM_Color_fl));
             }
         }
     }
@@ -331,6 +370,27 @@ std::string insert_texture_and_instance(
     return std::string();
 }
 
+namespace
+{
+    // Compute a hash of the contents of a dictionary.
+    asf::uint64 hash_dictionary(const asf::Dictionary& dictionary, asf::uint64 h)
+    {
+        for (auto i = dictionary.strings().begin(), e = dictionary.strings().end(); i != e; ++i)
+        {
+            h = hash_bytes(i.key(), std::strlen(i.key()) + 1, h);
+            h = hash_bytes(i.value(), std::strlen(i.value()) + 1, h);
+        }
+
+        for (auto i = dictionary.dictionaries().begin(), e = dictionary.dictionaries().end(); i != e; ++i)
+        {
+            h = hash_bytes(i.key(), std::strlen(i.key()) + 1, h);
+            h = hash_dictionary(i.value(), h);
+        }
+
+        return h;
+    }
+}
+
 std::string insert_bitmap_texture_and_instance(
     asr::BaseGroup& base_group,
     BitmapTex*      bitmap_tex,
@@ -348,7 +408,18 @@ std::string insert_bitmap_texture_and_instance(
         else texture_params.insert("color_space", "srgb");
     }
 
-    const std::string texture_name = wide_to_utf8(bitmap_tex->GetName());
+    // Textures are named after their file and parameters rather than after the texture map, so that
+    // texture maps referencing the same file share a single texture, and that texture maps with the
+    // same name but different files don't collide. File paths are compared case-insensitively.
+    asr::ParamArray texture_key_params(texture_params);
+    texture_key_params.insert("filename", normalize_path(filepath));
+
+    const std::string texture_name =
+        asf::format(
+            "{0}_{1}",
+            get_stem(filepath),
+            to_hex_string(hash_dictionary(texture_key_params, hash_bytes(nullptr, 0))));
+
     if (base_group.textures().get_by_name(texture_name.c_str()) == nullptr)
     {
         base_group.textures().insert(
@@ -358,7 +429,11 @@ std::string insert_bitmap_texture_and_instance(
                 asf::SearchPaths()));
     }
 
-    const std::string texture_instance_name = texture_name + "_inst";
+    // Texture instances are shared by uses of the texture with the same instance parameters.
+    const std::string texture_instance_name =
+        texture_instance_params.empty()
+            ? texture_name + "_inst"
+            : texture_name + "_inst_" + to_hex_string(hash_dictionary(texture_instance_params, hash_bytes(nullptr, 0)));
     if (base_group.texture_instances().get_by_name(texture_instance_name.c_str()) == nullptr)
     {
         base_group.texture_instances().insert(
@@ -377,7 +452,12 @@ namespace
       : public ShadeContext
     {
       public:
-        explicit MaxShadeContext(const asr::SourceInputs& source_inputs)
+        MaxShadeContext(const asr::SourceInputs& source_inputs, const TimeValue time)
+          : MaxShadeContext(source_inputs.m_uv_x, source_inputs.m_uv_y, time)
+        {
+        }
+
+        MaxShadeContext(const float u, const float v, const TimeValue time)
         {
             doMaps = TRUE;
             filterMaps = FALSE;
@@ -387,9 +467,14 @@ namespace
             xshadeID = 0;
             // todo: initialize `out`?
 
-            m_cur_time = GetCOREInterface()->GetTime();
-            m_uv.x = source_inputs.m_uv_x;
-            m_uv.y = source_inputs.m_uv_y;
+            m_cur_time = time;
+            set_uv(u, v);
+        }
+
+        void set_uv(const float u, const float v)
+        {
+            m_uv.x = u;
+            m_uv.y = v;
         }
 
         BOOL InMtlEditor() override
@@ -553,13 +638,34 @@ namespace
         Point3      m_view;             // unit vector from light to point, in light space
     };
 
+    // Return the resolution at which a texture map is best sampled.
+    void get_texmap_resolution(
+        Texmap*                         texmap,
+        size_t&                         width,
+        size_t&                         height)
+    {
+        if (is_bitmap_texture(texmap))
+        {
+            auto bitmap = static_cast<BitmapTex*>(texmap)->GetBitmap(0);
+            width = static_cast<size_t>(bitmap->Width());
+            height = static_cast<size_t>(bitmap->Height());
+        }
+        else
+        {
+            // Take a random guess.
+            width = 2048;
+            height = 1080;
+        }
+    }
+
     class MaxProceduralTextureSource
       : public asr::Source
     {
       public:
-        explicit MaxProceduralTextureSource(Texmap* texmap)
+        MaxProceduralTextureSource(Texmap* texmap, const TimeValue time)
           : asr::Source(false)
           , m_texmap(texmap)
+          , m_time(time)
         {
         }
 
@@ -571,20 +677,7 @@ namespace
         Hints get_hints() const override
         {
             Hints hints;
-
-            if (is_bitmap_texture(m_texmap))
-            {
-                auto bitmap = static_cast<BitmapTex*>(m_texmap)->GetBitmap(0);
-                hints.m_width = static_cast<size_t>(bitmap->Width());
-                hints.m_height = static_cast<size_t>(bitmap->Height());
-            }
-            else
-            {
-                // Take a random guess.
-                hints.m_width = 2048;
-                hints.m_height = 1080;
-            }
-
+            get_texmap_resolution(m_texmap, hints.m_width, hints.m_height);
             return hints;
         }
 
@@ -641,18 +734,19 @@ namespace
         }
 
       private:
-        Texmap* m_texmap;
+        Texmap*         m_texmap;
+        const TimeValue m_time;
 
         float evaluate_float(const asr::SourceInputs& source_inputs) const
         {
-            MaxShadeContext maxsc(source_inputs);
+            MaxShadeContext maxsc(source_inputs, m_time);
 
             return m_texmap->EvalMono(maxsc);
         }
 
         void evaluate_color(const asr::SourceInputs& source_inputs, float& r, float& g, float& b) const
         {
-            MaxShadeContext maxsc(source_inputs);
+            MaxShadeContext maxsc(source_inputs, m_time);
             
             const AColor tex_color = m_texmap->EvalColor(maxsc);
 
@@ -663,7 +757,7 @@ namespace
 
         void evaluate_color(const asr::SourceInputs& source_inputs, float& r, float& g, float& b, asr::Alpha& alpha) const
         {
-            MaxShadeContext maxsc(source_inputs);
+            MaxShadeContext maxsc(source_inputs, m_time);
             
             const AColor tex_color = m_texmap->EvalColor(maxsc);
 
@@ -675,13 +769,310 @@ namespace
         }
     };
 
+    // Serialize the evaluation of tiles of all baked texture maps. Texture maps may share sub-maps
+    // and the 3ds Max API is not designed to be called from several threads at once, hence tiles
+    // of different texture maps must not be evaluated concurrently either.
+    std::mutex g_texmap_evaluation_mutex;
+
+    // A texture map evaluated into a tiled 32-bit floating point RGBA image.
+    // Tiles are evaluated the first time they are accessed, possibly from rendering threads, and then kept.
+    // Kept tiles have a fifth channel holding the result of Texmap::EvalMono() for scalar lookups.
+    class BakedTexmap
+      : public asf::NonCopyable
+    {
+      public:
+        static const size_t ChannelCount = 5;
+
+        BakedTexmap(
+            Texmap*                         texmap,
+            const asf::CanvasProperties&    props,
+            const TimeValue                 time,
+            const asf::uint64               signature)
+          : m_texmap(texmap)
+          , m_props(props)
+          , m_time(time)
+          , m_signature(signature)
+          , m_tiles(new std::atomic<asf::Tile*>[props.m_tile_count])
+        {
+            for (size_t i = 0; i < m_props.m_tile_count; ++i)
+                m_tiles[i] = nullptr;
+        }
+
+        ~BakedTexmap()
+        {
+            for (size_t i = 0; i < m_props.m_tile_count; ++i)
+                delete m_tiles[i].load();
+        }
+
+        // Return the properties of the RGBA image.
+        const asf::CanvasProperties& properties() const
+        {
+            return m_props;
+        }
+
+        asf::uint64 get_signature() const
+        {
+            return m_signature;
+        }
+
+        // Return a given tile, evaluating it if necessary.
+        const asf::Tile& get_tile(const size_t tile_x, const size_t tile_y)
+        {
+            std::atomic<asf::Tile*>& slot = m_tiles[tile_y * m_props.m_tile_count_x + tile_x];
+
+            asf::Tile* tile = slot.load(std::memory_order_acquire);
+            if (tile == nullptr)
+            {
+                std::lock_guard<std::mutex> lock(g_texmap_evaluation_mutex);
+
+                tile = slot.load(std::memory_order_relaxed);
+                if (tile == nullptr)
+                {
+                    tile = evaluate_tile(tile_x, tile_y);
+                    slot.store(tile, std::memory_order_release);
+                }
+            }
+
+            return *tile;
+        }
+
+        // Return an RGBA copy of a given tile that the caller owns, without keeping it if it had to be evaluated.
+        asf::Tile* copy_tile(const size_t tile_x, const size_t tile_y)
+        {
+            std::unique_ptr<asf::Tile> evaluated_tile;
+            const asf::Tile* tile;
+            {
+                std::lock_guard<std::mutex> lock(g_texmap_evaluation_mutex);
+
+                tile = m_tiles[tile_y * m_props.m_tile_count_x + tile_x].load(std::memory_order_relaxed);
+                if (tile == nullptr)
+                {
+                    evaluated_tile.reset(evaluate_tile(tile_x, tile_y));
+                    tile = evaluated_tile.get();
+                }
+            }
+
+            asf::Tile* copy =
+                new asf::Tile(
+                    tile->get_width(),
+                    tile->get_height(),
+                    4,
+                    asf::PixelFormatFloat);
+
+            for (size_t y = 0, ye = tile->get_height(); y < ye; ++y)
+            {
+                for (size_t x = 0, xe = tile->get_width(); x < xe; ++x)
+                    std::memcpy(copy->pixel(x, y), tile->pixel(x, y), 4 * sizeof(float));
+            }
+
+            return copy;
+        }
+
+      private:
+        Texmap*                                     m_texmap;
+        const asf::CanvasProperties                 m_props;
+        const TimeValue                             m_time;
+        const asf::uint64                           m_signature;
+        std::unique_ptr<std::atomic<asf::Tile*>[]>  m_tiles;
+
+        asf::Tile* evaluate_tile(const size_t tile_x, const size_t tile_y) const
+        {
+            const size_t origin_x = tile_x * m_props.m_tile_width;
+            const size_t origin_y = tile_y * m_props.m_tile_height;
+
+            asf::Tile* tile =
+                new asf::Tile(
+                    std::min(m_props.m_tile_width, m_props.m_canvas_width - origin_x),
+                    std::min(m_props.m_tile_height, m_props.m_canvas_height - origin_y),
+                    ChannelCount,
+                    asf::PixelFormatFloat);
+
+            MaxShadeContext maxsc(0.0f, 0.0f, m_time);
+
+            for (size_t y = 0, ye = tile->get_height(); y < ye; ++y)
+            {
+                const float v = 1.0f - (origin_y + y + 0.5f) / m_props.m_canvas_height;
+
+                for (size_t x = 0, xe = tile->get_width(); x < xe; ++x)
+                {
+                    const float u = (origin_x + x + 0.5f) / m_props.m_canvas_width;
+
+                    maxsc.set_uv(u, v);
+                    const AColor color = m_texmap->EvalColor(maxsc);
+
+                    float* pixel = reinterpret_cast<float*>(tile->pixel(x, y));
+                    pixel[0] = color.r;
+                    pixel[1] = color.g;
+                    pixel[2] = color.b;
+                    pixel[3] = color.a;
+                    pixel[4] = m_texmap->EvalMono(maxsc);
+                }
+            }
+
+            return tile;
+        }
+    };
+
+    // A source that looks up texels of a baked procedural texture with bilinear filtering.
+    class BakedMaxProceduralTextureSource
+      : public asr::Source
+    {
+      public:
+        explicit BakedMaxProceduralTextureSource(BakedTexmap& baked_texmap)
+          : asr::Source(false)
+          , m_baked_texmap(baked_texmap)
+        {
+        }
+
+        asf::uint64 compute_signature() const override
+        {
+            return m_baked_texmap.get_signature();
+        }
+
+        Hints get_hints() const override
+        {
+            const asf::CanvasProperties& props = m_baked_texmap.properties();
+
+            Hints hints;
+            hints.m_width = props.m_canvas_width;
+            hints.m_height = props.m_canvas_height;
+            return hints;
+        }
+
+        void evaluate(
+            asr::TextureCache&          texture_cache,
+            const asr::SourceInputs&    source_inputs,
+            float&                      scalar) const override
+        {
+            scalar = lookup_mono(source_inputs);
+        }
+
+        void evaluate(
+            asr::TextureCache&          texture_cache,
+            const asr::SourceInputs&    source_inputs,
+            asf::Color3f&               linear_rgb) const override
+        {
+            const asf::Color4f color = lookup_color(source_inputs);
+            linear_rgb = color.rgb();
+        }
+
+        void evaluate(
+            asr::TextureCache&          texture_cache,
+            const asr::SourceInputs&    source_inputs,
+            asr::Spectrum&              spectrum) const override
+        {
+            DbgAssert(spectrum.size() == 3);
+            const asf::Color4f color = lookup_color(source_inputs);
+            spectrum[0] = color.r;
+            spectrum[1] = color.g;
+            spectrum[2] = color.b;
+        }
+
+        void evaluate(
+            asr::TextureCache&          texture_cache,
+            const asr::SourceInputs&    source_inputs,
+            asr::Alpha&                 alpha) const override
+        {
+            alpha.set(lookup_mono(source_inputs));
+        }
+
+        void evaluate(
+            asr::TextureCache&          texture_cache,
+            const asr::SourceInputs&    source_inputs,
+            asf::Color3f&               linear_rgb,
+            asr::Alpha&                 alpha) const override
+        {
+            const asf::Color4f color = lookup_color(source_inputs);
+            linear_rgb = color.rgb();
+            alpha.set(color.a);
+        }
+
+        void evaluate(
+            asr::TextureCache&          texture_cache,
+            const asr::SourceInputs&    source_inputs,
+            asr::Spectrum&              spectrum,
+            asr::Alpha&                 alpha) const override
+        {
+            DbgAssert(spectrum.size() == 3);
+            const asf::Color4f color = lookup_color(source_inputs);
+            spectrum[0] = color.r;
+            spectrum[1] = color.g;
+            spectrum[2] = color.b;
+            alpha.set(color.a);
+        }
+
+      private:
+        BakedTexmap& m_baked_texmap;
+
+        const float* texel(const int x, const int y) const
+        {
+            const asf::CanvasProperties& props = m_baked_texmap.properties();
+            const asf::Tile& tile = m_baked_texmap.get_tile(x / props.m_tile_width, y / props.m_tile_height);
+            return reinterpret_cast<const float*>(tile.pixel(x % props.m_tile_width, y % props.m_tile_height));
+        }
+
+        // Look up channels [first_channel, first_channel + channel_count) of the baked texture map.
+        void lookup(
+            const asr::SourceInputs&    source_inputs,
+            const size_t                first_channel,
+            const size_t                channel_count,
+            float*                      result) const
+        {
+            const asf::CanvasProperties& props = m_baked_texmap.properties();
+            const int width = static_cast<int>(props.m_canvas_width);
+            const int height = static_cast<int>(props.m_canvas_height);
+
+            // Texel centers are at half-integer coordinates; the texture repeats.
+            const float fx = source_inputs.m_uv_x * width - 0.5f;
+            const float fy = (1.0f - source_inputs.m_uv_y) * height - 0.5f;
+            const float floor_x = std::floor(fx);
+            const float floor_y = std::floor(fy);
+            const float wx = fx - floor_x;
+            const float wy = fy - floor_y;
+
+            const int x0 = ((static_cast<int>(floor_x) % width) + width) % width;
+            const int y0 = ((static_cast<int>(floor_y) % height) + height) % height;
+            const int x1 = x0 + 1 < width ? x0 + 1 : 0;
+            const int y1 = y0 + 1 < height ? y0 + 1 : 0;
+
+            const float* t00 = texel(x0, y0);
+            const float* t10 = texel(x1, y0);
+            const float* t01 = texel(x0, y1);
+            const float* t11 = texel(x1, y1);
+
+            for (size_t i = 0; i < channel_count; ++i)
+            {
+                const size_t c = first_channel + i;
+                const float top = t00[c] + (t10[c] - t00[c]) * wx;
+                const float bottom = t01[c] + (t11[c] - t01[c]) * wx;
+                result[i] = top + (bottom - top) * wy;
+            }
+        }
+
+        asf::Color4f lookup_color(const asr::SourceInputs& source_inputs) const
+        {
+            float result[4];
+            lookup(source_inputs, 0, 4, result);
+            return asf::Color4f(result[0], result[1], result[2], result[3]);
+        }
+
+        float lookup_mono(const asr::SourceInputs& source_inputs) const
+        {
+            float result;
+            lookup(source_inputs, 4, 1, &result);
+            return result;
+        }
+    };
+
     class MaxProceduralTexture
       : public asr::Texture
     {
       public:
-        MaxProceduralTexture(const char* name, Texmap* texmap)
+        // `time` is the time at which the texture map is evaluated.
+        MaxProceduralTexture(const char* name, Texmap* texmap, const TimeValue time)
           : asr::Texture(name, asr::ParamArray())
           , m_texmap(texmap)
+          , m_time(time)
         {
             // Dummy values.
             m_properties =
@@ -715,14 +1106,20 @@ namespace
             const asf::UniqueID         assembly_uid,
             const asr::TextureInstance& texture_instance) override
         {
-            return new MaxProceduralTextureSource(m_texmap);
+            if (m_baked_texmap.get() != nullptr)
+                return new BakedMaxProceduralTextureSource(*m_baked_texmap);
+
+            return new MaxProceduralTextureSource(m_texmap, m_time);
         }
 
         asf::Tile* load_tile(
             const size_t                tile_x,
             const size_t                tile_y) override
         {
-            return nullptr;
+            if (m_baked_texmap.get() == nullptr)
+                return nullptr;
+
+            return m_baked_texmap->copy_tile(tile_x, tile_y);
         }
 
         void unload_tile(
@@ -730,11 +1127,64 @@ namespace
             const size_t                tile_y,
             const asf::Tile*            tile) override
         {
+            delete tile;
+        }
+
+        // Serve all lookups from an image of the texture map instead of evaluating it for every sample.
+        // If `lazy` is false, the whole image is evaluated right away, otherwise tiles are evaluated
+        // the first time they are accessed. Must be called from the main thread.
+        void bake(
+            const size_t                width,
+            const size_t                height,
+            const size_t                tile_size,
+            const bool                  lazy)
+        {
+            const asf::CanvasProperties props(
+                width, height,
+                tile_size, tile_size,
+                4, asf::PixelFormatFloat);
+
+            // The signature of the baked image depends on the texture map and on how it is baked.
+            // Texture maps whose parameters can't be hashed get a signature of their own.
+            asf::uint64 signature;
+            if (!compute_texmap_signature(m_texmap, m_time, signature))
+            {
+                static std::atomic<asf::uint64> uncacheable_bake_count(0);
+                const asf::uint64 bake_index = uncacheable_bake_count++;
+                signature = hash_bytes(&bake_index, sizeof(bake_index), hash_bytes(&m_texmap, sizeof(m_texmap)));
+            }
+            const size_t bake_params[3] = { width, height, tile_size };
+            signature = hash_bytes(bake_params, sizeof(bake_params), signature);
+            signature = hash_bytes(&m_time, sizeof(m_time), signature);
+
+            m_baked_texmap.reset(new BakedTexmap(m_texmap, props, m_time, signature));
+
+            m_properties = m_baked_texmap->properties();
+
+            if (!lazy)
+            {
+                for (size_t ty = 0; ty < m_properties.m_tile_count_y; ++ty)
+                {
+                    for (size_t tx = 0; tx < m_properties.m_tile_count_x; ++tx)
+                        m_baked_texmap->get_tile(tx, ty);
+                }
+            }
+
+            RENDERER_LOG_DEBUG(
+                "%s procedural texture \"%s\" at %sx%s pixels with %sx%s tiles.",
+                lazy ? "lazily baking" : "baked",
+                get_name(),
+                asf::pretty_uint(width).c_str(),
+                asf::pretty_uint(height).c_str(),
+                asf::pretty_uint(tile_size).c_str(),
+                asf::pretty_uint(tile_size).c_str());
         }
 
       private:
-        asf::CanvasProperties   m_properties;
-        Texmap*                 m_texmap;
+        asf::CanvasProperties           m_properties;
+        Texmap*                         m_texmap;
+        const TimeValue                 m_time;
+        std::unique_ptr<BakedTexmap>    m_baked_texmap;
     };
 
     void load_map_files_recursively(MtlBase* mat_base, TimeValue time)
@@ -760,7 +1210,7 @@ std::string insert_procedural_texture_and_instance(
     asr::ParamArray texture_params,
     asr::ParamArray texture_instance_params)
 {
-    const TimeValue time = GetCOREInterface()->GetTime();
+    const TimeValue time = get_shading_time();
     texmap->Update(time, FOREVER);
     load_map_files_recursively(texmap, time);
 
@@ -773,10 +1223,33 @@ std::string insert_procedural_texture_and_instance(
     const std::string texture_name = wide_to_utf8(texmap->GetName());
     if (base_group.textures().get_by_name(texture_name.c_str()) == nullptr)
     {
-        base_group.textures().insert(
-            asf::auto_release_ptr<asr::Texture>(
-                new MaxProceduralTexture(
-                    texture_name.c_str(), texmap)));
+        asf::auto_release_ptr<MaxProceduralTexture> texture(
+            new MaxProceduralTexture(
+                texture_name.c_str(), texmap, time));
+
+        // Optionally bake the texture map. System settings can be overridden per texture.
+        if (texture_params.get_optional<bool>("bake", load_system_setting(L"BakeProceduralMaps", false)))
+        {
+            size_t width, height;
+            get_texmap_resolution(texmap, width, height);
+
+            const size_t max_resolution = load_system_setting<size_t>(L"BakedProceduralMapMaxResolution", 2048);
+            if (width > max_resolution || height > max_resolution)
+            {
+                const double scale = static_cast<double>(max_resolution) / std::max(width, height);
+                width = std::max<size_t>(static_cast<size_t>(width * scale), 1);
+                height = std::max<size_t>(static_cast<size_t>(height * scale), 1);
+            }
+
+            // Lazy baking evaluates the texture map from rendering threads, one tile at a time.
+            texture->bake(
+                std::max<size_t>(texture_params.get_optional<size_t>("bake_width", width), 1),
+                std::max<size_t>(texture_params.get_optional<size_t>("bake_height", height), 1),
+                std::max<size_t>(texture_params.get_optional<size_t>("bake_tile_size", load_system_setting<size_t>(L"BakedProceduralMapTileSize", 64)), 1),
+                texture_params.get_optional<bool>("bake_lazily", load_system_setting(L"BakeProceduralMapsLazily", true)));
+        }
+
+        base_group.textures().insert(asf::auto_release_ptr<asr::Texture>(texture.release()));
     }
 
     const std::string texture_instance_name = texture_name + "_inst";
@@ -791,3 +1264,40 @@ std::string insert_procedural_texture_and_instance(
 
     return texture_instance_name;
 }
+
+namespace
+{
+    thread_local UniqueNameRegistry* g_current_unique_name_registry = nullptr;
+}
+
+UniqueNameRegistry::UniqueNameRegistry()
+  : m_previous(g_current_unique_name_registry)
+{
+    g_current_unique_name_registry = this;
+}
+
+UniqueNameRegistry::~UniqueNameRegistry()
+{
+    g_current_unique_name_registry = m_previous;
+}
+
+UniqueNameRegistry* UniqueNameRegistry::current()
+{
+    return g_current_unique_name_registry;
+}
+
+std::string to_hex_string(const asf::uint64 value)
+{
+    std::stringstream sstr;
+    sstr << std::hex << std::setw(16) << std::setfill('0') << value;
+    return sstr.str();
+}
+
+size_t get_thread_count(const int requested_thread_count)
+{
+    if (requested_thread_count > 0)
+        return static_cast<size_t>(requested_thread_count);
+
+    const int core_count = static_cast<int>(std::thread::hardware_concurrency());
+    return static_cast<size_t>(std::max(core_count + requested_thread_count, 1));
+}
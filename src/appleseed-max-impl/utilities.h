@@ -37,8 +37,11 @@
 #include "foundation/image/image.h"
 #include "foundation/math/matrix.h"
 #include "foundation/math/vector.h"
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/platform/types.h"
 #include "foundation/platform/windows.h"    // include before 3ds Max headers
 #include "foundation/utility/autoreleaseptr.h"
+#include "foundation/utility/string.h"
 
 // 3ds Max headers.
 #include <assert1.h>
@@ -53,8 +56,16 @@
 #include <point4.h>
 
 // Standard headers.
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstring>
+#include <exception>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 // Forward declarations.
 namespace renderer  { class BaseGroup; }
@@ -114,6 +125,12 @@ std::string get_root_path();
 // Replace the file extension in `file_path` by `new_ext` (which must be of the form ".ext").
 WStr replace_extension(const WStr& file_path, const WStr& new_ext);
 
+// Return a form of `file_path` suitable for comparing paths: lowercase, with backslash separators.
+std::string normalize_path(const std::string& file_path);
+
+// Return the file name of `file_path`, without directory and extension.
+std::string get_stem(const std::string& file_path);
+
 // Write a block of data to a 3ds Max file. Return true on success.
 bool write(ISave* isave, const void* data, const size_t size);
 
@@ -158,6 +175,37 @@ foundation::auto_release_ptr<foundation::Image> render_bitmap_to_image(
 // Project construction functions.
 //
 
+// While an instance of this class exists, make_unique_name() calls made from the same thread
+// remember the last suffix used for each name, per container, so that generating a unique name
+// only takes a constant number of lookups on average. As without a registry, a returned name
+// only becomes unavailable once an entity with this name is inserted into the container.
+class UniqueNameRegistry
+  : public foundation::NonCopyable
+{
+  public:
+    UniqueNameRegistry();
+    ~UniqueNameRegistry();
+
+    // Return the registry of the calling thread, or nullptr if there is none.
+    static UniqueNameRegistry* current();
+
+    template <typename EntityContainer>
+    std::string make_unique_name(
+        const EntityContainer&  entities,
+        const std::string&      name);
+
+  private:
+    struct ContainerNames
+    {
+        std::string                                 m_last_name;    // name returned by the last call
+        std::unordered_map<std::string, size_t>     m_suffixes;     // last suffix used for each name
+    };
+
+    UniqueNameRegistry*                                 m_previous;
+    std::unordered_map<const void*, ContainerNames>     m_containers;
+};
+
+// Return `name` if no entity of `entities` has this name, otherwise a unique name derived from `name`.
 template <typename EntityContainer>
 std::string make_unique_name(
     const EntityContainer&  entities,
@@ -188,6 +236,39 @@ std::string insert_procedural_texture_and_instance(
     renderer::ParamArray    texture_instance_params = renderer::ParamArray());
 
 
+//
+// Hashing functions.
+//
+
+// Compute a 64-bit hash of a block of memory. The block is processed 8 bytes at a time, hence
+// hashing large arrays costs little more than reading them. Hashes of several blocks can be
+// chained by passing the previous hash as `h`.
+foundation::uint64 hash_bytes(
+    const void*                 data,
+    const size_t                size,
+    foundation::uint64          h = 14695981039346656037ull);
+
+// Format a 64-bit value as a 16-digit hexadecimal string.
+std::string to_hex_string(const foundation::uint64 value);
+
+
+//
+// Threading functions.
+//
+
+// Return the number of threads to use for a given thread count setting.
+// A value of 0 means as many threads as there are logical cores, a negative
+// value -n means as many threads as there are logical cores minus n.
+size_t get_thread_count(const int requested_thread_count);
+
+// Call `func(i)` for every i in [0, count) using up to `thread_count` threads,
+// the calling thread included. `func` must be safe to call concurrently for
+// distinct values of i. The first exception thrown by `func`, if any, is
+// rethrown in the calling thread once all threads have finished.
+template <typename Func>
+void parallel_for(const size_t count, const size_t thread_count, const Func& func);
+
+
 //
 // Plugcfg ini file access functions.
 //
@@ -318,15 +399,119 @@ inline IOResult read(ILoad* iload, MSTR* s)
     return result;
 }
 
+template <typename EntityContainer>
+std::string UniqueNameRegistry::make_unique_name(
+    const EntityContainer&  entities,
+    const std::string&      name)
+{
+    ContainerNames& container_names = m_containers[&entities];
+
+    // Containers are identified by their address, which a container created after another one
+    // was destroyed may reuse. Suffixes are forgotten if the container lacks the name returned
+    // by the last call, which then either belongs to another container or was never used.
+    if (!container_names.m_last_name.empty() &&
+        entities.get_by_name(container_names.m_last_name.c_str()) == nullptr)
+        container_names.m_suffixes.clear();
+
+    if (entities.get_by_name(name.c_str()) == nullptr)
+    {
+        container_names.m_last_name = name;
+        return name;
+    }
+
+    // Resume from the last suffix used for this name.
+    size_t& suffix = container_names.m_suffixes[name];
+    while (true)
+    {
+        std::string candidate = name + "_" + foundation::to_string(++suffix);
+        if (entities.get_by_name(candidate.c_str()) == nullptr)
+        {
+            container_names.m_last_name = candidate;
+            return candidate;
+        }
+    }
+}
+
 template <typename EntityContainer>
 std::string make_unique_name(
     const EntityContainer&  entities,
     const std::string&      name)
 {
+    UniqueNameRegistry* registry = UniqueNameRegistry::current();
+    if (registry != nullptr)
+        return registry->make_unique_name(entities, name);
+
     return
         entities.get_by_name(name.c_str()) == nullptr
             ? name
-            : asr::make_unique_name(name + "_", entities);
+            : renderer::make_unique_name(name + "_", entities);
+}
+
+inline foundation::uint64 hash_bytes(
+    const void*                 data,
+    const size_t                size,
+    foundation::uint64          h)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    const size_t word_count = size / sizeof(foundation::uint64);
+
+    for (size_t i = 0; i < word_count; ++i)
+    {
+        foundation::uint64 word;
+        std::memcpy(&word, bytes + i * sizeof(word), sizeof(word));
+        h = (h ^ word) * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 29;
+    }
+
+    // Remaining bytes are hashed one at a time (FNV-1a).
+    for (size_t i = word_count * sizeof(foundation::uint64); i < size; ++i)
+        h = (h ^ bytes[i]) * 1099511628211ull;
+
+    return h;
+}
+
+template <typename Func>
+void parallel_for(const size_t count, const size_t thread_count, const Func& func)
+{
+    std::atomic<size_t> next_index(0);
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            const size_t i = next_index++;
+            if (i >= count)
+                break;
+
+            try
+            {
+                func(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(exception_mutex);
+                if (!exception)
+                    exception = std::current_exception();
+
+                // Prevent other threads from picking up new work.
+                next_index = count;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1, e = std::min(thread_count, count); i < e; ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (auto& thread : threads)
+        thread.join();
+
+    if (exception)
+        std::rethrow_exception(exception);
 }
 
 template <typename T>